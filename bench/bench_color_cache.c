@@ -0,0 +1,126 @@
+/*
+ * bench_color_cache.c
+ *
+ * Compares filling frames of typical content with and without the encoded color cache, and
+ * reports how many LEDs were copied from the previous LED or from the cache.
+ */
+
+#include "ws2812b.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LED_COUNT (64 * 1024)
+#define ROUNDS 100
+
+typedef struct {
+  const char *name;
+  void (*generate)(ws2812b_led_t *leds, uint32_t count);
+} workload_t;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void generate_black(ws2812b_led_t *leds, uint32_t count) {
+  memset(leds, 0, sizeof(ws2812b_led_t) * count);
+}
+
+// Gradient with plateaus: The color changes every 32 LEDs.
+static void generate_plateaus(ws2812b_led_t *leds, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    uint8_t step = (i / 32) * 8;
+    leds[i] = (ws2812b_led_t){step, 255 - step, step / 2};
+  }
+}
+
+// A few short sprites on black.
+static void generate_sprites(ws2812b_led_t *leds, uint32_t count) {
+  generate_black(leds, count);
+  for (uint32_t i = 0; i + 8 <= count; i += 200) {
+    for (uint32_t j = 0; j < 8; j++) {
+      leds[i + j] = (ws2812b_led_t){255, 32 * j, 0};
+    }
+  }
+}
+
+// Every LED is one of 8 colors.
+static void generate_few_colors(ws2812b_led_t *leds, uint32_t count) {
+  static const ws2812b_led_t colors[8] = {{255, 0, 0},   {0, 255, 0},   {0, 0, 255},
+                                          {255, 255, 0}, {0, 255, 255}, {255, 0, 255},
+                                          {255, 255, 255}, {0, 0, 0}};
+  srand(1);
+  for (uint32_t i = 0; i < count; i++) {
+    leds[i] = colors[rand() % 8];
+  }
+}
+
+static void generate_noise(ws2812b_led_t *leds, uint32_t count) {
+  srand(2);
+  for (uint32_t i = 0; i < count; i++) {
+    leds[i] = (ws2812b_led_t){rand(), rand(), rand()};
+  }
+}
+
+static const workload_t workloads[] = {
+    {"black", generate_black},         {"plateaus", generate_plateaus},
+    {"sprites", generate_sprites},     {"8 colors", generate_few_colors},
+    {"noise", generate_noise},
+};
+
+static double time_fill(ws2812b_handle_t *h, uint8_t *buf) {
+  ws2812b_fill_buffer(h, buf);
+
+  double start = now();
+  for (uint32_t round = 0; round < ROUNDS; round++) {
+    ws2812b_fill_buffer(h, buf);
+  }
+  return (now() - start) / ROUNDS;
+}
+
+int main(void) {
+  ws2812b_led_t *leds = malloc(sizeof(ws2812b_led_t) * LED_COUNT);
+  ws2812b_color_cache_t cache;
+
+  ws2812b_handle_t h;
+  h.led_count = LED_COUNT;
+  h.leds = leds;
+  h.config.packing = WS2812B_PACKING_SINGLE;
+  h.config.pulse_len_0 = WS2812B_PULSE_LEN_2b;
+  h.config.pulse_len_1 = WS2812B_PULSE_LEN_6b;
+  h.config.first_bit_0 = WS2812B_FIRST_BIT_0_ENABLED;
+  h.config.spi_bit_order = WS2812B_MSB_FIRST;
+  h.config.prefix_len = 1;
+  h.config.suffix_len = 4;
+  if (ws2812b_init(&h)) {
+    printf("Init failed: %s\n", ws2812b_error_msg);
+    return 1;
+  }
+
+  uint8_t *buf = malloc(ws2812b_required_buffer_len(&h));
+  memset(buf, 0, ws2812b_required_buffer_len(&h));
+
+  printf("bench_color_cache: %u LEDs, %u cache entries\n", LED_COUNT, WS2812B_COLOR_CACHE_LEN);
+  printf("  %-10s %12s %12s %8s %8s\n", "workload", "uncached", "cached", "runs", "hits");
+
+  for (uint32_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+    workloads[w].generate(leds, LED_COUNT);
+
+    ws2812b_set_color_cache(&h, 0);
+    double uncached = time_fill(&h, buf);
+
+    ws2812b_set_color_cache(&h, &cache);
+    double cached = time_fill(&h, buf);
+    double total = cache.runs + cache.hits + cache.misses;
+
+    printf("  %-10s %9.3f ms %9.3f ms %7.1f%% %7.1f%%\n", workloads[w].name, uncached * 1e3,
+           cached * 1e3, cache.runs / total * 100, cache.hits / total * 100);
+  }
+
+  free(buf);
+  free(leds);
+  return 0;
+}
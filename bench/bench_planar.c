@@ -0,0 +1,89 @@
+/*
+ * bench_planar.c
+ *
+ * Compares filling frames from interleaved ws2812b_led_t LEDs with filling them from planar
+ * (one array per channel) storage, in both packing modes.
+ */
+
+#include "ws2812b.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LED_COUNT (64 * 1024)
+#define ROUNDS 100
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double time_fill(ws2812b_handle_t *h, uint8_t *buf) {
+  ws2812b_fill_buffer(h, buf);
+
+  double start = now();
+  for (uint32_t round = 0; round < ROUNDS; round++) {
+    ws2812b_fill_buffer(h, buf);
+  }
+  return (now() - start) / ROUNDS;
+}
+
+int main(void) {
+  ws2812b_led_t *leds = malloc(sizeof(ws2812b_led_t) * LED_COUNT);
+  uint8_t *red = aligned_alloc(WS2812B_PLANE_ALIGN, LED_COUNT);
+  uint8_t *green = aligned_alloc(WS2812B_PLANE_ALIGN, LED_COUNT);
+  uint8_t *blue = aligned_alloc(WS2812B_PLANE_ALIGN, LED_COUNT);
+
+  srand(1);
+  for (uint32_t i = 0; i < LED_COUNT; i++) {
+    leds[i] = (ws2812b_led_t){rand(), rand(), rand()};
+    red[i] = leds[i].red;
+    green[i] = leds[i].green;
+    blue[i] = leds[i].blue;
+  }
+  ws2812b_planar_t planes = {red, green, blue};
+
+  printf("bench_planar: %u LEDs\n", LED_COUNT);
+  printf("  %-8s %12s %12s %8s\n", "packing", "interleaved", "planar", "speedup");
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  const char *names[] = {"single", "double"};
+  for (uint32_t p = 0; p < 2; p++) {
+    ws2812b_handle_t h;
+    h.led_count = LED_COUNT;
+    h.leds = leds;
+    h.config.packing = packings[p];
+    h.config.pulse_len_0 = WS2812B_PULSE_LEN_1b;
+    h.config.pulse_len_1 = WS2812B_PULSE_LEN_2b;
+    h.config.first_bit_0 = WS2812B_FIRST_BIT_0_ENABLED;
+    h.config.spi_bit_order = WS2812B_MSB_FIRST;
+    h.config.prefix_len = 1;
+    h.config.suffix_len = 4;
+    if (ws2812b_init(&h)) {
+      printf("Init failed: %s\n", ws2812b_error_msg);
+      return 1;
+    }
+
+    uint8_t *buf = malloc(ws2812b_required_buffer_len(&h));
+    memset(buf, 0, ws2812b_required_buffer_len(&h));
+
+    double interleaved = time_fill(&h, buf);
+    if (ws2812b_set_source_planar(&h, &planes)) {
+      printf("Planar source failed: %s\n", ws2812b_error_msg);
+      return 1;
+    }
+    double planar = time_fill(&h, buf);
+
+    printf("  %-8s %9.3f ms %9.3f ms %7.2fx\n", names[p], interleaved * 1e3, planar * 1e3,
+           interleaved / planar);
+    free(buf);
+  }
+
+  free(blue);
+  free(green);
+  free(red);
+  free(leds);
+  return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * bench_streaming.c
+ *
+ * Measures how filling a very large buffer affects a renderer that works on
+ * a cache-sized data set. The renderer runs right after every fill, on the
+ * same thread, and is timed on whatever of its data the fill left in the
+ * cache. Built once with regular stores and once with
+ * WS2812B_ENABLE_STREAMING_STORES (see makefile).
+ */
+
+#define _GNU_SOURCE
+#include "ws2812b.h"
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LED_COUNT (2 * 1024 * 1024)      // 48MiB encoded buffer in single packing
+#define RENDER_LEN (1024 * 1024)         // Renderer working set
+#define ROUNDS 10
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int open_cache_miss_counter(void) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Simple "effect": Updates every LED of the render buffer, depending on the previous state.
+static void render(ws2812b_led_t *leds, uint32_t count, uint32_t frame) {
+  for (uint32_t i = 0; i < count; i++) {
+    leds[i].red = leds[i].red + (uint8_t)frame;
+    leds[i].green = leds[i].green ^ leds[i].red;
+    leds[i].blue = leds[i].blue + leds[i].green;
+  }
+}
+
+int main(void) {
+  ws2812b_led_t *leds = malloc(sizeof(ws2812b_led_t) * LED_COUNT);
+  ws2812b_led_t *render_leds = malloc(sizeof(ws2812b_led_t) * RENDER_LEN);
+  memset(leds, 0xa5, sizeof(ws2812b_led_t) * LED_COUNT);
+  memset(render_leds, 0x11, sizeof(ws2812b_led_t) * RENDER_LEN);
+
+  ws2812b_handle_t h;
+  h.led_count = LED_COUNT;
+  h.leds = leds;
+  h.config.packing = WS2812B_PACKING_SINGLE;
+  h.config.pulse_len_0 = WS2812B_PULSE_LEN_2b;
+  h.config.pulse_len_1 = WS2812B_PULSE_LEN_6b;
+  h.config.first_bit_0 = WS2812B_FIRST_BIT_0_ENABLED;
+  h.config.spi_bit_order = WS2812B_MSB_FIRST;
+  h.config.prefix_len = 1;
+  h.config.suffix_len = 4;
+  if (ws2812b_init(&h)) {
+    printf("Init failed: %s\n", ws2812b_error_msg);
+    return 1;
+  }
+
+  uint8_t *buf = malloc(ws2812b_required_buffer_len(&h));
+  memset(buf, 0, ws2812b_required_buffer_len(&h));
+
+  int counter = open_cache_miss_counter();
+
+#ifdef WS2812B_ENABLE_STREAMING_STORES
+  printf("bench_streaming: streaming stores above %lu bytes\n",
+         (unsigned long)WS2812B_STREAMING_THRESHOLD);
+#else
+  printf("bench_streaming: regular stores\n");
+#endif
+
+  double fill_time = 0;
+  double render_time = 0;
+  long long render_misses = 0;
+
+  for (uint32_t round = 0; round < ROUNDS; round++) {
+    // Warm up renderer working set
+    render(render_leds, RENDER_LEN, round);
+
+    double start = now();
+    ws2812b_fill_buffer(&h, buf);
+    fill_time += now() - start;
+
+    // Renderer runs again after the fill, and suffers from any data evicted by it.
+    if (counter >= 0) {
+      ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+      ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    start = now();
+    render(render_leds, RENDER_LEN, round);
+    render_time += now() - start;
+    if (counter >= 0) {
+      long long misses = 0;
+      ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(counter, &misses, sizeof(misses)) == sizeof(misses)) {
+        render_misses += misses;
+      }
+    }
+  }
+
+  printf("  fill:   %8.3f ms/frame (%.2f GB/s)\n", fill_time / ROUNDS * 1e3,
+         ws2812b_required_buffer_len(&h) / (fill_time / ROUNDS) * 1e-9);
+  printf("  render: %8.3f ms/frame after fill\n", render_time / ROUNDS * 1e3);
+  if (counter >= 0) {
+    printf("  render: %8lld cache misses/frame after fill\n", render_misses / ROUNDS);
+  } else {
+    printf("  render: cache misses not available (perf_event_open failed)\n");
+  }
+
+  free(buf);
+  free(render_leds);
+  free(leds);
+  return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * bench_uring.c
+ *
+ * Frame rate of a single thread encoding and submitting frames for many
+ * outputs through io_uring. /dev/null stands in for the SPI devices.
+ */
+
+#include "ws2812b.h"
+#include "ws2812b_uring.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define OUTPUT_COUNT 32
+#define LED_COUNT 300
+#define DURATION_S 2.0
+
+// Output each buffer was last queued for, and whether an output has a write in flight.
+static uint32_t buffer_output[OUTPUT_COUNT];
+static bool output_busy[OUTPUT_COUNT];
+
+static void on_complete(void *ctx, uint32_t buffer_index, int result) {
+  (void)ctx;
+  (void)result;
+  output_busy[buffer_output[buffer_index]] = false;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void) {
+  ws2812b_led_t leds[LED_COUNT];
+  memset(leds, 0x42, sizeof(leds));
+
+  ws2812b_handle_t h;
+  h.led_count = LED_COUNT;
+  h.leds = leds;
+  h.config.packing = WS2812B_PACKING_SINGLE;
+  h.config.pulse_len_0 = WS2812B_PULSE_LEN_2b;
+  h.config.pulse_len_1 = WS2812B_PULSE_LEN_6b;
+  h.config.first_bit_0 = WS2812B_FIRST_BIT_0_ENABLED;
+  h.config.spi_bit_order = WS2812B_MSB_FIRST;
+  h.config.prefix_len = 1;
+  h.config.suffix_len = 4;
+  if (ws2812b_init(&h)) {
+    printf("Init failed: %s\n", ws2812b_error_msg);
+    return 1;
+  }
+
+  uint32_t frame_len = ws2812b_required_buffer_len(&h);
+  uint8_t *buffers[OUTPUT_COUNT];
+  for (uint32_t i = 0; i < OUTPUT_COUNT; i++) {
+    buffers[i] = malloc(frame_len);
+  }
+
+  int fds[OUTPUT_COUNT];
+  for (uint32_t o = 0; o < OUTPUT_COUNT; o++) {
+    fds[o] = open("/dev/null", O_WRONLY);
+  }
+
+  ws2812b_uring_t ur;
+  ur.config.buffers = buffers;
+  ur.config.buffer_count = OUTPUT_COUNT;
+  ur.config.buffer_len = frame_len;
+  ur.config.on_complete = on_complete;
+  ur.config.ctx = 0;
+  if (ws2812b_uring_init(&ur)) {
+    printf("bench_uring: io_uring not available.\n");
+    return 0;
+  }
+
+  printf("bench_uring: %u outputs, %u LEDs each, %s buffers\n", OUTPUT_COUNT, LED_COUNT,
+         ur.fixed_buffers ? "fixed" : "regular");
+
+  // One buffer per output, and at most one write per output in flight, so that every output's
+  // frames stay in order. While the writes of some outputs are in flight, the frames of the
+  // others are encoded.
+  double start = now();
+  uint64_t frames = 0;
+  while (now() - start < DURATION_S) {
+    for (uint32_t o = 0; o < OUTPUT_COUNT; o++) {
+      while (output_busy[o]) {
+        ws2812b_uring_reap(&ur, 1);
+      }
+      int index = ws2812b_uring_acquire(&ur);
+      leds[0].red = frames;
+      ws2812b_fill_buffer(&h, buffers[index]);
+      ws2812b_uring_queue(&ur, fds[o], index, frame_len);
+      buffer_output[index] = o;
+      output_busy[o] = true;
+    }
+    ws2812b_uring_submit(&ur);
+    ws2812b_uring_reap(&ur, 0);
+    frames += OUTPUT_COUNT;
+  }
+  ws2812b_uring_reap(&ur, ur.in_flight + ur.queued);
+  double elapsed = now() - start;
+
+  printf("  %.0f frames/s total, %.0f frames/s per output, %llu errors\n", frames / elapsed,
+         frames / elapsed / OUTPUT_COUNT, (unsigned long long)ur.errors);
+
+  ws2812b_uring_close(&ur);
+  for (uint32_t o = 0; o < OUTPUT_COUNT; o++) {
+    close(fds[o]);
+  }
+  for (uint32_t i = 0; i < OUTPUT_COUNT; i++) {
+    free(buffers[i]);
+  }
+  return 0;
+}
@@ -7,9 +7,23 @@
 
 #include "ws2812b.h"
 #include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) && !defined(WS2812B_DISABLE_SIMD)
+#include <emmintrin.h>
+#define WS2812B_SIMD_SSE2
+#endif
+
+#if defined(WS2812B_ENABLE_STREAMING_STORES) && defined(__SSE2__)
+#include <emmintrin.h>
+#define WS2812B_STREAMING_STORES
+#endif
 
 // ======== Private Macros =========================================================================
 
+// Number of LEDs loaded and encoded at once.
+#define WS2812B_BLOCK_LEN 16
+
 #define WS2812B_BYTE_REVERSE(_x_)                                                                  \
   (((_x_ & 0x80) >> 7) | ((_x_ & 0x40) >> 5) | ((_x_ & 0x20) >> 3) | ((_x_ & 0x10) >> 1) |         \
    ((_x_ & 0x08) << 1) | ((_x_ & 0x04) << 3) | ((_x_ & 0x02) << 5) | ((_x_ & 0x01) << 7))
@@ -33,6 +47,82 @@ char error_msg_buf[WS2812B_ERROR_MSG_MAX_LEN];
 
 #endif /* WS2812B_ERROR_MSG_MAX_LEN */
 
+#ifndef WS2812B_DISABLE_RGB565
+
+// Expansion of 4, 5 and 6-bit channels to 8 bits, by repeating the high bits.
+static const uint8_t expand_4[16] = {
+    0, 17, 34, 51, 68, 85, 102, 119, 136, 153, 170, 187, 204, 221, 238, 255};
+
+static const uint8_t expand_5[32] = {
+    0,   8,   16,  24,  33,  41,  49,  57,  66,  74,  82,  90,  99,  107, 115, 123,
+    132, 140, 148, 156, 165, 173, 181, 189, 198, 206, 214, 222, 231, 239, 247, 255};
+
+static const uint8_t expand_6[64] = {
+    0,   4,   8,   12,  16,  20,  24,  28,  32,  36,  40,  44,  48,  52,  56,  60,
+    65,  69,  73,  77,  81,  85,  89,  93,  97,  101, 105, 109, 113, 117, 121, 125,
+    130, 134, 138, 142, 146, 150, 154, 158, 162, 166, 170, 174, 178, 182, 186, 190,
+    195, 199, 203, 207, 211, 215, 219, 223, 227, 231, 235, 239, 243, 247, 251, 255};
+
+#endif /* WS2812B_DISABLE_RGB565 */
+
+// Shared zeros for prefix/suffix segments. Not const so that it is placed
+// in RAM, which all DMA controllers can read from.
+static uint8_t zero_block[WS2812B_ZERO_BLOCK_LEN];
+
+#ifndef WS2812B_DISABLE_HSV
+
+// Hue to color conversion. The hue range is split into sectors, and in every sector, each channel
+// is a linear function of the offset into the sector (0..255):
+// base + (rise * offset) / 256 - (fall * offset) / 256.
+typedef struct {
+  uint8_t base[8][3];
+  uint16_t rise[8][3];
+  uint16_t fall[8][3];
+} hsv_table_t;
+
+// 6 sectors, in R, G, B order.
+static const hsv_table_t hsv_spectrum = {
+    .base = {{255, 0, 0}, {255, 255, 0}, {0, 255, 0}, {0, 255, 255}, {0, 0, 255}, {255, 0, 255}},
+    .rise = {{0, 256, 0}, {0, 0, 0}, {0, 0, 256}, {0, 0, 0}, {256, 0, 0}, {0, 0, 0}},
+    .fall = {{0, 0, 0}, {256, 0, 0}, {0, 0, 0}, {0, 256, 0}, {0, 0, 0}, {0, 0, 256}},
+};
+
+// 8 sectors, in R, G, B order.
+static const hsv_table_t hsv_rainbow = {
+    .base = {{255, 0, 0},
+             {171, 85, 0},
+             {171, 170, 0},
+             {0, 255, 0},
+             {0, 171, 85},
+             {0, 0, 255},
+             {85, 0, 171},
+             {170, 0, 85}},
+    .rise = {{0, 85, 0},
+             {0, 85, 0},
+             {0, 85, 0},
+             {0, 0, 85},
+             {0, 0, 170},
+             {85, 0, 0},
+             {85, 0, 0},
+             {85, 0, 0}},
+    .fall = {{85, 0, 0},
+             {0, 0, 0},
+             {170, 0, 0},
+             {0, 85, 0},
+             {0, 170, 0},
+             {0, 0, 85},
+             {0, 0, 85},
+             {0, 0, 85}},
+};
+
+#endif /* WS2812B_DISABLE_HSV */
+
+#if defined(__GNUC__) && WS2812B_LAYOUT_PREFETCH > 0
+#define WS2812B_PREFETCH(_ptr_) __builtin_prefetch(_ptr_)
+#else
+#define WS2812B_PREFETCH(_ptr_) ((void)(_ptr_))
+#endif
+
 #define WS2812B_INIT_ASSERT(_assertion_, _error_msg_)                                              \
   do {                                                                                             \
     if (!(_assertion_)) {                                                                          \
@@ -41,10 +131,150 @@ char error_msg_buf[WS2812B_ERROR_MSG_MAX_LEN];
     }                                                                                              \
   } while (0)
 
+// Adjustments that depend on the LED or the frame, so that colors can not be encoded once and
+// reused, see fill_adjusted.
+#if !defined(WS2812B_DISABLE_CORRECTION) || !defined(WS2812B_DISABLE_POWER_LIMIT)
+#define WS2812B_PER_LED_ADJUSTMENTS
+#endif
+
 // ======== Private Prototypes =====================================================================
 
 static void set_init_error_msg(const char *error_msg);
+static int init_pulses(ws2812b_handle_t *ws);
+static void build_retarget_table(ws2812b_handle_t *ws, uint8_t old_pulse_0, uint8_t old_pulse_1,
+                                 ws2812b_order_t old_order, uint8_t *table);
+static uint8_t retarget_pulse(ws2812b_handle_t *ws, uint8_t old_pulse_0, uint8_t old_pulse_1,
+                              uint8_t pulse);
+static void retarget_range(const uint8_t *table, const uint8_t *pulses, uint32_t pulse_count,
+                           uint8_t *data, uint32_t len);
+static void encode_leds(ws2812b_handle_t *ws, uint8_t *data_buffer);
+static void encode_fixed_colors(ws2812b_handle_t *ws, const ws2812b_led_t *leds, uint32_t count,
+                                uint8_t *dst);
+static void fill_constant(ws2812b_handle_t *ws, uint8_t *buffer, const uint8_t *encoded,
+                          uint32_t first, uint32_t count);
+#ifdef WS2812B_PER_LED_ADJUSTMENTS
+static void fill_adjusted(ws2812b_handle_t *ws, uint8_t *buffer, ws2812b_led_t color,
+                          uint32_t first, uint32_t count);
+#endif /* WS2812B_PER_LED_ADJUSTMENTS */
+static void replicate(uint8_t *dst, uint32_t len, uint32_t total_len);
+static uint32_t clamp_range(ws2812b_handle_t *ws, uint32_t first, uint32_t count);
+static void rotate_slots(ws2812b_handle_t *ws, uint8_t *data, uint32_t count, uint32_t shift);
+static void reverse_slots(ws2812b_handle_t *ws, uint8_t *data, uint32_t count);
+static void moved_leds(ws2812b_handle_t *ws, uint8_t *data, uint32_t first, uint32_t count);
+static void mark_stale(ws2812b_handle_t *ws, uint32_t first, uint32_t count);
+static void load_colors(ws2812b_handle_t *ws, uint32_t first, uint32_t count, uint8_t *colors);
+static void load_colors_leds(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                             uint8_t *colors);
+#ifndef WS2812B_DISABLE_LAYOUTS
+static void load_colors_layout(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                               uint8_t *colors);
+static uint32_t layout_run(const ws2812b_layout_t *layout, uint32_t led, uint32_t *index,
+                           int32_t *step);
+#endif /* WS2812B_DISABLE_LAYOUTS */
+#ifndef WS2812B_DISABLE_LED16
+static void load_colors_led16(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                              uint8_t *colors);
+static uint8_t dither(uint16_t value, uint8_t *error);
+#endif /* WS2812B_DISABLE_LED16 */
+#ifndef WS2812B_DISABLE_FLOAT
+static void load_colors_float(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                              uint8_t *colors);
+static float load_float(const ws2812b_float_source_t *source, const void *channel, uint32_t i);
+static float half_to_float(uint16_t half);
+#endif /* WS2812B_DISABLE_FLOAT */
+#ifndef WS2812B_DISABLE_HSV
+static void load_colors_hsv(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                            uint8_t *colors);
+#endif /* WS2812B_DISABLE_HSV */
+#ifndef WS2812B_DISABLE_PALETTE
+static void load_colors_palette(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                                uint8_t *colors);
+#endif /* WS2812B_DISABLE_PALETTE */
+#ifndef WS2812B_DISABLE_PIXELS
+static void load_colors_pixels(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                               uint8_t *colors, uint8_t *white);
+#endif /* WS2812B_DISABLE_PIXELS */
+#ifndef WS2812B_DISABLE_PLANAR
+static void load_colors_planar(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                               uint8_t *colors);
+static bool planar_direct(ws2812b_handle_t *ws);
+#endif /* WS2812B_DISABLE_PLANAR */
+#ifndef WS2812B_DISABLE_RGB565
+static void load_colors_rgb565(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                               uint8_t *colors);
+static void load_colors_rgb444(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                               uint8_t *colors);
+#endif /* WS2812B_DISABLE_RGB565 */
+#ifndef WS2812B_DISABLE_SHADER
+static void load_colors_shader(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                               uint8_t *colors);
+#endif /* WS2812B_DISABLE_SHADER */
+#ifndef WS2812B_DISABLE_RGB565
+static void expand_tables(ws2812b_handle_t *ws, const uint8_t **red, const uint8_t **green,
+                          const uint8_t **blue);
+#endif /* WS2812B_DISABLE_RGB565 */
+#ifndef WS2812B_DISABLE_CURVES
+static bool expand_merged(ws2812b_handle_t *ws);
+#endif /* WS2812B_DISABLE_CURVES */
+#ifndef WS2812B_DISABLE_PLANAR
+static void encode_planar(ws2812b_handle_t *ws, uint32_t first, uint32_t count, uint8_t *dst);
+#ifdef WS2812B_SIMD_SSE2
+static void encode_planes_16(ws2812b_handle_t *ws, const __m128i *values, uint8_t *dst);
+#endif /* WS2812B_SIMD_SSE2 */
+#endif /* WS2812B_DISABLE_PLANAR */
+#ifndef WS2812B_DISABLE_PIXELS
+static void to_wire_order(const ws2812b_pixel_format_t *format, uint32_t count, uint8_t *colors,
+                          const uint8_t *white);
+#endif /* WS2812B_DISABLE_PIXELS */
+static uint32_t channel_count(ws2812b_handle_t *ws);
+static uint32_t data_len(ws2812b_handle_t *ws, uint32_t led_count);
+static uint32_t iter_data_len(ws2812b_handle_t *ws);
+#ifndef WS2812B_DISABLE_PALETTE
+static uint32_t palette_index(const ws2812b_palette_t *palette, uint32_t led);
+static const uint8_t *palette_encoded(ws2812b_handle_t *ws);
+static void encode_leds_palette(ws2812b_handle_t *ws, uint8_t *data_buffer);
+#endif /* WS2812B_DISABLE_PALETTE */
+#ifndef WS2812B_DISABLE_CORRECTION
+static void apply_color_matrix(const ws2812b_color_matrix_t *matrix, uint32_t count,
+                               uint8_t *colors);
+#endif /* WS2812B_DISABLE_CORRECTION */
+#ifndef WS2812B_DISABLE_CURVES
+static void apply_curves(ws2812b_handle_t *ws, uint32_t count, uint8_t *colors);
+static bool curves_enabled(ws2812b_handle_t *ws);
+#endif /* WS2812B_DISABLE_CURVES */
+#ifndef WS2812B_DISABLE_CORRECTION
+static void apply_calibration(const ws2812b_gain_t *gains, uint32_t count, uint8_t *colors);
+#endif /* WS2812B_DISABLE_CORRECTION */
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+static void apply_power_limit(ws2812b_power_t *power, uint32_t count, uint8_t *colors,
+                              uint8_t *white);
+static void power_frame_start(ws2812b_handle_t *ws, uint8_t *data_buffer);
+static void power_frame_end(ws2812b_handle_t *ws, uint8_t *data_buffer);
+static void scale_encoded(ws2812b_handle_t *ws, uint8_t *data_buffer, uint32_t scale);
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+static uint8_t decode_color(ws2812b_handle_t *ws, const uint8_t *src);
+#if !defined(WS2812B_DISABLE_CURVES) || !defined(WS2812B_DISABLE_FLOAT)
+static void generate_curve(uint8_t *curve, uint32_t len, float gamma, uint8_t brightness);
+static float curve_pow(float x, float gamma);
+#endif
+static void encode_colors(ws2812b_handle_t *ws, const uint8_t *colors, uint32_t count,
+                          uint8_t *dst);
+static void encode_block(ws2812b_handle_t *ws, const uint8_t *colors, uint32_t count,
+                         uint8_t *dst);
+static void encode_range(ws2812b_handle_t *ws, uint32_t first, uint32_t count, uint8_t *dst);
+#ifndef WS2812B_DISABLE_COLOR_CACHE
+static void encode_colors_cached(ws2812b_handle_t *ws, const uint8_t *colors, uint32_t count,
+                                 uint8_t *dst);
+#endif /* WS2812B_DISABLE_COLOR_CACHE */
+static void clean_cache_range(ws2812b_handle_t *ws, uint8_t *start, uint32_t len);
 static void add_byte(ws2812b_handle_t *ws, uint8_t value, uint8_t **buffer);
+static uint32_t add_zero_segments(uint32_t len, ws2812b_segment_t *segments);
+#ifdef WS2812B_STREAMING_STORES
+static void encode_leds_streaming(ws2812b_handle_t *ws, uint8_t *data_buffer);
+#endif /* WS2812B_STREAMING_STORES */
+static uint8_t iter_data_next(ws2812b_handle_t *ws, uint32_t i, uint32_t *iteration_index);
+static int check_chain(ws2812b_handle_t **handles, uint32_t count);
+static void chain_iter_skip_finished(ws2812b_chain_t *chain);
 static uint8_t construct_single_pulse(ws2812b_handle_t *ws, uint_fast8_t b, uint8_t value);
 static uint8_t construct_double_pulse(ws2812b_handle_t *ws, uint_fast8_t b, uint8_t value);
 
@@ -60,86 +290,647 @@ int ws2812b_init(ws2812b_handle_t *ws) {
   ws2812b_error_msg = 0;
 #endif /* WS2812B_DISABLE_ERROR_MSG */
 
-  // Assert packing is valid
-  WS2812B_INIT_ASSERT((ws->config.packing == WS2812B_PACKING_DOUBLE) ||
-                          (ws->config.packing == WS2812B_PACKING_SINGLE),
-                      "ws2812b: config.packing is invalid!");
+  if (init_pulses(ws)) {
+    return -1;
+  }
 
-  // Assert pulse_len_1 is valid
-  WS2812B_INIT_ASSERT(WS2812B_IS_PULSE_LEN(ws->config.pulse_len_1),
-                      "ws2812b: config.pulse_len_1 is invalid!");
+  ws->state.iteration_index = 0;
 
-  // Asert pulse_len_0 is valid
-  WS2812B_INIT_ASSERT(WS2812B_IS_PULSE_LEN(ws->config.pulse_len_0),
-                      "ws2812b: config.pulse_len_0 is invalid!");
+  ws->state.clean_range = 0;
+  ws->state.cache_line_len = 1;
 
-  // Assert first_bit_0 is valid
-  WS2812B_INIT_ASSERT((ws->config.first_bit_0 == WS2812B_FIRST_BIT_0_DISABLED) ||
-                          (ws->config.first_bit_0 == WS2812B_FIRST_BIT_0_ENABLED),
-                      "ws2812b: config.first_bit_0 is invalid!");
+  ws->state.curves[WS2812B_CHANNEL_RED] = 0;
+  ws->state.curves[WS2812B_CHANNEL_GREEN] = 0;
+  ws->state.curves[WS2812B_CHANNEL_BLUE] = 0;
 
-  // Assert spi_bit_order is valid
-  WS2812B_INIT_ASSERT((ws->config.spi_bit_order == WS2812B_LSB_FIRST) ||
-                          (ws->config.spi_bit_order == WS2812B_MSB_FIRST),
-                      "ws2812b: config.spi_bit_order is invalid!");
+  ws->state.color_matrix = 0;
+  ws->state.calibration = 0;
+  ws->state.power = 0;
+  ws->state.color_cache = 0;
+  ws->state.blackout = 0;
+  ws->state.layout = 0;
+  ws->state.stale_first = 0;
+  ws->state.stale_end = 0;
 
-  // Assert that the '1' pulse is longer than the '0' pulse:
-  WS2812B_INIT_ASSERT(ws->config.pulse_len_1 > ws->config.pulse_len_0,
-                      "ws2812b: One-pulse must be longer than zero-pulse!");
+  ws->state.source = WS2812B_SOURCE_LEDS;
+  ws->state.pixel_format = 0;
+  ws->state.source_data = 0;
+  ws->state.source_state = 0;
 
-  // Assert that pulse is not too long if in double packing:
+  return 0;
+}
+
+int ws2812b_retarget(ws2812b_handle_t *ws, const ws2812b_config_t *config, uint8_t *buffer) {
+
+  // Assert that the buffer layout stays the same
+  WS2812B_INIT_ASSERT(config->packing == ws->config.packing &&
+                          config->prefix_len == ws->config.prefix_len &&
+                          config->suffix_len == ws->config.suffix_len,
+                      "ws2812b: retarget can not change buffer layout!");
+
+  ws2812b_config_t old_config = ws->config;
+  uint8_t old_pulse_0 = ws->state.pulse_0;
+  uint8_t old_pulse_1 = ws->state.pulse_1;
+
+  ws->config = *config;
+  if (init_pulses(ws)) {
+    ws->config = old_config;
+    return -1;
+  }
+
+  // Encoded data only consists of pulses, which are substituted byte by byte. In double
+  // packing, every byte holds two pulses, so there are four possible bytes.
+  uint8_t table[256];
+  build_retarget_table(ws, old_pulse_0, old_pulse_1, old_config.spi_bit_order, table);
+
+  uint8_t pulses[4] = {old_pulse_0, old_pulse_1};
+  uint32_t pulse_count = 2;
   if (ws->config.packing == WS2812B_PACKING_DOUBLE) {
-    WS2812B_INIT_ASSERT(ws->config.pulse_len_1 < WS2812B_PULSE_LEN_4b,
-                        "ws2812b: Pulse is too long for double packing!");
+    pulses[0] = old_pulse_0 | old_pulse_0 << 4;
+    pulses[1] = old_pulse_0 | old_pulse_1 << 4;
+    pulses[2] = old_pulse_1 | old_pulse_0 << 4;
+    pulses[3] = old_pulse_1 | old_pulse_1 << 4;
+    pulse_count = 4;
   }
 
-  // Apply 0 prefix to pulse if selected
-  ws->state.pulse_0 = ws->config.pulse_len_0 << ws->config.first_bit_0;
-  ws->state.pulse_1 = ws->config.pulse_len_1 << ws->config.first_bit_0;
+  uint32_t len = data_len(ws, ws->led_count);
 
-  // Pulse needs to be reverse for MSB-first transmission:
-  if (ws->config.spi_bit_order == WS2812B_MSB_FIRST) {
-    if (ws->config.packing == WS2812B_PACKING_DOUBLE) {
-      ws->state.pulse_0 = WS2812B_NIBBLE_REVERSE(ws->state.pulse_0);
-      ws->state.pulse_1 = WS2812B_NIBBLE_REVERSE(ws->state.pulse_1);
-    } else {
-      ws->state.pulse_0 = WS2812B_BYTE_REVERSE(ws->state.pulse_0);
-      ws->state.pulse_1 = WS2812B_BYTE_REVERSE(ws->state.pulse_1);
+  if (buffer != 0) {
+    uint8_t *data = buffer + ws->config.prefix_len;
+    retarget_range(table, pulses, pulse_count, data, len);
+    clean_cache_range(ws, data, len);
+  }
+
+  // Encoded data kept by the handle
+#ifndef WS2812B_DISABLE_PALETTE
+  if (ws->state.source == WS2812B_SOURCE_PALETTE) {
+    const ws2812b_palette_t *palette = ws->state.source_data;
+    retarget_range(table, pulses, pulse_count, palette->encoded,
+                   palette->size * data_len(ws, 1));
+  }
+#endif /* WS2812B_DISABLE_PALETTE */
+
+  // Cache entries always hold 3-channel colors, whatever the current source.
+#ifndef WS2812B_DISABLE_COLOR_CACHE
+  ws2812b_color_cache_t *cache = ws->state.color_cache;
+  uint32_t entry_len = WS2812B_DATA_LEN(1, ws->config.packing);
+  entry_len = entry_len < sizeof(cache->entries[0].encoded) ? entry_len
+                                                            : sizeof(cache->entries[0].encoded);
+  for (uint32_t i = 0; cache != 0 && i < WS2812B_COLOR_CACHE_LEN; i++) {
+    if (cache->entries[i].color != ~0U) {
+      retarget_range(table, pulses, pulse_count, cache->entries[i].encoded, entry_len);
     }
   }
+#endif /* WS2812B_DISABLE_COLOR_CACHE */
 
-  ws->state.iteration_index = 0;
+  if (ws->state.blackout != 0) {
+    uint8_t *data = ws->state.blackout + ws->config.prefix_len;
+    retarget_range(table, pulses, pulse_count, data, len);
+    clean_cache_range(ws, data, len);
+  }
+
+  return 0;
+}
+
+int ws2812b_set_clean_hook(ws2812b_handle_t *ws, ws2812b_clean_range_t clean_range,
+                           uint32_t cache_line_len) {
+
+  // Assert cache line length is a power of two
+  WS2812B_INIT_ASSERT(cache_line_len != 0 && (cache_line_len & (cache_line_len - 1)) == 0,
+                      "ws2812b: cache line length is invalid!");
+
+  ws->state.clean_range = clean_range;
+  ws->state.cache_line_len = cache_line_len;
+
+  return 0;
+}
+
+#ifndef WS2812B_DISABLE_CURVES
+
+int ws2812b_set_color_curve(ws2812b_handle_t *ws, ws2812b_channel_t ch, const uint8_t *curve) {
+
+  // Assert channel is valid
+  WS2812B_INIT_ASSERT(ch == WS2812B_CHANNEL_RED || ch == WS2812B_CHANNEL_GREEN ||
+                          ch == WS2812B_CHANNEL_BLUE,
+                      "ws2812b: color channel is invalid!");
+
+  // Channels without a curve are passed through unchanged.
+  ws->state.curves[ch] = curve;
+
+#ifndef WS2812B_DISABLE_RGB565
+  ws2812b_update_expand_tables(ws);
+#endif /* WS2812B_DISABLE_RGB565 */
+  return 0;
+}
+
+void ws2812b_generate_color_curve(uint8_t *curve, float gamma, uint8_t brightness) {
+  generate_curve(curve, 256, gamma, brightness);
+}
+
+#endif /* WS2812B_DISABLE_CURVES */
+
+#ifndef WS2812B_DISABLE_LED16
+
+void ws2812b_set_source_led16(ws2812b_handle_t *ws, const ws2812b_led16_t *leds,
+                              ws2812b_led_t *dither_errors) {
+  ws->state.source = WS2812B_SOURCE_LED16;
+  ws->state.source_data = leds;
+  ws->state.source_state = dither_errors;
+
+  if (dither_errors != 0) {
+    memset(dither_errors, 0, ws->led_count * sizeof(ws2812b_led_t));
+  }
+}
+
+#endif /* WS2812B_DISABLE_LED16 */
+
+#ifndef WS2812B_DISABLE_FLOAT
+
+void ws2812b_set_source_float(ws2812b_handle_t *ws, const ws2812b_float_source_t *source) {
+  ws->state.source = WS2812B_SOURCE_FLOAT;
+  ws->state.source_data = source;
+  ws->state.source_state = 0;
+}
+
+void ws2812b_generate_transfer_curve(uint8_t *curve, float gamma, uint8_t brightness) {
+  generate_curve(curve, WS2812B_TRANSFER_CURVE_LEN, gamma, brightness);
+}
+
+#endif /* WS2812B_DISABLE_FLOAT */
+
+#ifndef WS2812B_DISABLE_HSV
+
+void ws2812b_set_source_hsv(ws2812b_handle_t *ws, const ws2812b_hsv_t *leds,
+                            ws2812b_hsv_mode_t mode) {
+  ws->state.source =
+      mode == WS2812B_HSV_RAINBOW ? WS2812B_SOURCE_HSV_RAINBOW : WS2812B_SOURCE_HSV_SPECTRUM;
+  ws->state.source_data = leds;
+  ws->state.source_state = 0;
+}
+
+#endif /* WS2812B_DISABLE_HSV */
+
+#ifndef WS2812B_DISABLE_PIXELS
+
+int ws2812b_set_source_pixels(ws2812b_handle_t *ws, const uint8_t *pixels,
+                              const ws2812b_pixel_format_t *format) {
+
+  // Assert channel count is valid
+  WS2812B_INIT_ASSERT(format->channels == 3 || format->channels == 4,
+                      "ws2812b: pixel channel count is invalid!");
+
+  // Assert every channel is sent exactly once, and lies within a pixel
+  uint32_t sent = 0;
+  for (uint32_t i = 0; i < format->channels; i++) {
+    WS2812B_INIT_ASSERT(format->order[i] < format->channels, "ws2812b: pixel order is invalid!");
+    WS2812B_INIT_ASSERT(format->offsets[i] < format->stride, "ws2812b: pixel offset is invalid!");
+    sent |= 1U << format->order[i];
+  }
+  WS2812B_INIT_ASSERT(sent == (1U << format->channels) - 1, "ws2812b: pixel order is invalid!");
+
+  ws->state.source = WS2812B_SOURCE_PIXELS;
+  ws->state.pixel_format = format;
+  ws->state.source_data = pixels;
+  ws->state.source_state = 0;
+
+  return 0;
+}
+
+#endif /* WS2812B_DISABLE_PIXELS */
+
+#ifndef WS2812B_DISABLE_PLANAR
+
+int ws2812b_set_source_planar(ws2812b_handle_t *ws, const ws2812b_planar_t *planes) {
+
+  // Assert planes are aligned
+  uintptr_t addresses = (uintptr_t)planes->red | (uintptr_t)planes->green | (uintptr_t)planes->blue;
+  WS2812B_INIT_ASSERT(addresses % WS2812B_PLANE_ALIGN == 0, "ws2812b: planes are not aligned!");
+
+  ws->state.source = WS2812B_SOURCE_PLANAR;
+  ws->state.source_data = planes;
+  ws->state.source_state = 0;
+
+  return 0;
+}
+
+#endif /* WS2812B_DISABLE_PLANAR */
+
+#ifndef WS2812B_DISABLE_RGB565
+
+void ws2812b_set_source_rgb565(ws2812b_handle_t *ws, const uint16_t *leds,
+                               ws2812b_expand_tables_t *tables) {
+  ws->state.source = WS2812B_SOURCE_RGB565;
+  ws->state.source_data = leds;
+  ws->state.source_state = tables;
+  ws2812b_update_expand_tables(ws);
+}
+
+void ws2812b_set_source_rgb444(ws2812b_handle_t *ws, const uint8_t *leds,
+                               ws2812b_expand_tables_t *tables) {
+  ws->state.source = WS2812B_SOURCE_RGB444;
+  ws->state.source_data = leds;
+  ws->state.source_state = tables;
+  ws2812b_update_expand_tables(ws);
+}
+
+void ws2812b_set_rgb444(uint8_t *leds, uint32_t index, ws2812b_led_t color) {
+  uint8_t *led = &leds[3 * index / 2];
+  if (index % 2 == 0) {
+    led[0] = (color.red & 0xF0) | color.green >> 4;
+    led[1] = (color.blue & 0xF0) | (led[1] & 0x0F);
+  } else {
+    led[0] = (led[0] & 0xF0) | color.red >> 4;
+    led[1] = (color.green & 0xF0) | color.blue >> 4;
+  }
+}
+
+void ws2812b_update_expand_tables(ws2812b_handle_t *ws) {
+  // Fills the caller's expansion tables. Called whenever the source, the color curves, the color
+  // matrix or the calibration is set. Curves changed in place require an explicit call.
+  if ((ws->state.source != WS2812B_SOURCE_RGB565 && ws->state.source != WS2812B_SOURCE_RGB444) ||
+      ws->state.source_state == 0) {
+    return;
+  }
+
+  ws2812b_expand_tables_t *tables = ws->state.source_state;
+  bool rgb565 = ws->state.source == WS2812B_SOURCE_RGB565;
+  const uint8_t *expand[3] = {rgb565 ? expand_5 : expand_4, rgb565 ? expand_6 : expand_4,
+                              rgb565 ? expand_5 : expand_4};
+  uint32_t len[3] = {rgb565 ? 32 : 16, rgb565 ? 64 : 16, rgb565 ? 32 : 16};
+  uint8_t *dst[3] = {tables->red, tables->green, tables->blue};
+#ifndef WS2812B_DISABLE_CURVES
+  bool merged = expand_merged(ws);
+#else
+  bool merged = false;
+#endif /* WS2812B_DISABLE_CURVES */
+
+  for (uint32_t c = 0; c < 3; c++) {
+    for (uint32_t v = 0; v < len[c]; v++) {
+      const uint8_t *curve = merged ? ws->state.curves[c] : 0;
+      dst[c][v] = curve != 0 ? curve[expand[c][v]] : expand[c][v];
+    }
+  }
+}
+
+#endif /* WS2812B_DISABLE_RGB565 */
+
+#ifndef WS2812B_DISABLE_SHADER
+
+int ws2812b_set_source_shader(ws2812b_handle_t *ws, const ws2812b_shader_t *shader) {
+
+  // Assert there is something to call
+  WS2812B_INIT_ASSERT(shader->color_at != 0 || shader->colors_at != 0,
+                      "ws2812b: shader has no function!");
+
+  ws->state.source = WS2812B_SOURCE_SHADER;
+  ws->state.source_data = shader;
+  ws->state.source_state = 0;
+
+  return 0;
+}
+
+#endif /* WS2812B_DISABLE_SHADER */
+
+#ifndef WS2812B_DISABLE_PALETTE
+
+int ws2812b_set_source_palette(ws2812b_handle_t *ws, ws2812b_palette_t *palette) {
+
+  // Assert index width is valid
+  WS2812B_INIT_ASSERT(palette->bits == 4 || palette->bits == 8,
+                      "ws2812b: palette bits are invalid!");
+
+  // Assert palette size fits the index width
+  WS2812B_INIT_ASSERT(palette->size != 0 && palette->size <= (1U << palette->bits),
+                      "ws2812b: palette size is invalid!");
+
+  ws->state.source = WS2812B_SOURCE_PALETTE;
+  ws->state.source_data = palette;
+  ws->state.source_state = 0;
+  ws2812b_update_palette(ws);
+
+  return 0;
+}
+
+void ws2812b_update_palette(ws2812b_handle_t *ws) {
+  // Entries are encoded with the color matrix and curves applied. Calibration and the power
+  // limit depend on the LED and the frame, so while either is enabled, LEDs are encoded from
+  // the palette colors one by one instead.
+  const ws2812b_palette_t *palette = ws->state.source_data;
+  encode_fixed_colors(ws, palette->colors, palette->size, palette->encoded);
+}
+
+#endif /* WS2812B_DISABLE_PALETTE */
+
+#ifndef WS2812B_DISABLE_CORRECTION
+
+void ws2812b_set_color_matrix(ws2812b_handle_t *ws, const ws2812b_color_matrix_t *matrix) {
+  // The identity matrix is not applied at all.
+  bool identity = true;
+  for (uint32_t row = 0; matrix != 0 && row < 3; row++) {
+    for (uint32_t col = 0; col < 3; col++) {
+      identity = identity && matrix->m[row][col] == (row == col ? WS2812B_COLOR_MATRIX_ONE : 0);
+    }
+  }
+
+  ws->state.color_matrix = identity ? 0 : matrix;
+#ifndef WS2812B_DISABLE_RGB565
+  ws2812b_update_expand_tables(ws);
+#endif /* WS2812B_DISABLE_RGB565 */
+}
+
+void ws2812b_color_matrix_identity(ws2812b_color_matrix_t *matrix) {
+  for (uint32_t row = 0; row < 3; row++) {
+    for (uint32_t col = 0; col < 3; col++) {
+      matrix->m[row][col] = row == col ? WS2812B_COLOR_MATRIX_ONE : 0;
+    }
+  }
+}
+
+void ws2812b_color_matrix_white_point(ws2812b_color_matrix_t *matrix, uint8_t red, uint8_t green,
+                                      uint8_t blue) {
+  // Scale every output channel, so that full white becomes the given color.
+  uint8_t white[3] = {red, green, blue};
+  for (uint32_t row = 0; row < 3; row++) {
+    for (uint32_t col = 0; col < 3; col++) {
+      int32_t scaled = matrix->m[row][col] * white[row];
+      matrix->m[row][col] = (scaled + (scaled >= 0 ? 127 : -127)) / 255;
+    }
+  }
+}
+
+void ws2812b_set_calibration(ws2812b_handle_t *ws, const ws2812b_gain_t *gains) {
+  ws->state.calibration = gains;
+#ifndef WS2812B_DISABLE_RGB565
+  ws2812b_update_expand_tables(ws);
+#endif /* WS2812B_DISABLE_RGB565 */
+}
+
+#endif /* WS2812B_DISABLE_CORRECTION */
+
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+
+void ws2812b_set_power_limit(ws2812b_handle_t *ws, ws2812b_power_t *power) {
+  ws->state.power = power;
+
+  if (power != 0) {
+    power->scale = 256;
+    power->sums[0] = power->sums[1] = power->sums[2] = power->sums[3] = 0;
+    power->requested_ma = 0;
+    power->output_ma = 0;
+    power->frames = 0;
+    power->limited = 0;
+  }
+}
+
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+
+#ifndef WS2812B_DISABLE_COLOR_CACHE
+
+void ws2812b_set_color_cache(ws2812b_handle_t *ws, ws2812b_color_cache_t *cache) {
+  ws->state.color_cache = cache;
+
+  if (cache != 0) {
+    for (uint32_t i = 0; i < WS2812B_COLOR_CACHE_LEN; i++) {
+      cache->entries[i].color = ~0U;
+    }
+    cache->last_color = ~0U;
+    cache->last_entry = 0;
+    cache->runs = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+  }
+}
+
+#endif /* WS2812B_DISABLE_COLOR_CACHE */
+
+#ifndef WS2812B_DISABLE_LAYOUTS
+
+int ws2812b_set_layout(ws2812b_handle_t *ws, const ws2812b_layout_t *layout) {
+
+  // Assert the rules cover every LED exactly
+  if (layout != 0 && layout->table == 0) {
+    uint64_t len = (uint64_t)layout->tile_width * layout->tile_height * layout->tiles_x;
+    WS2812B_INIT_ASSERT(len * layout->tiles_y == ws->led_count,
+                        "ws2812b: layout does not match LED count!");
+  }
+
+  ws->state.layout = layout;
 
   return 0;
 }
 
+#endif /* WS2812B_DISABLE_LAYOUTS */
+
 uint32_t ws2812b_required_buffer_len(ws2812b_handle_t *ws) {
-  return WS2812B_REQUIRED_BUFFER_LEN(ws->led_count, ws->config.packing, ws->config.prefix_len,
-                                     ws->config.suffix_len);
+  return ws->config.prefix_len + data_len(ws, ws->led_count) + ws->config.suffix_len;
 }
 
 void ws2812b_fill_buffer(ws2812b_handle_t *ws, uint8_t *buffer) {
-  ws2812b_led_t *led = ws->leds;
+  uint8_t *buffer_start = buffer;
 
   // Add 0x00 prefix
-  for (uint_fast8_t i = 0; i < ws->config.prefix_len; i++) {
+  for (uint32_t i = 0; i < ws->config.prefix_len; i++) {
     *buffer = 0x00;
     buffer++;
   }
 
   // Fill buffer
-  for (uint32_t i = 0; i < ws->led_count; i++) {
-    add_byte(ws, led->green, &buffer);
-    add_byte(ws, led->red, &buffer);
-    add_byte(ws, led->blue, &buffer);
-    led++;
-  }
+  encode_leds(ws, buffer);
+  buffer += data_len(ws, ws->led_count);
 
   // Add 0x00 suffix
-  for (uint_fast8_t i = 0; i < ws->config.suffix_len; i++) {
+  for (uint32_t i = 0; i < ws->config.suffix_len; i++) {
     *buffer = 0x00;
     buffer++;
   }
+
+  clean_cache_range(ws, buffer_start, buffer - buffer_start);
+}
+
+void ws2812b_fill_solid(ws2812b_handle_t *ws, uint8_t *buffer, ws2812b_led_t color,
+                        uint32_t first, uint32_t count) {
+  // The color is adjusted like a palette entry: Color matrix and curves are applied. Calibration
+  // and the power limit depend on the LED and the frame, so while either is enabled, every LED
+  // is adjusted and encoded on its own.
+#ifdef WS2812B_PER_LED_ADJUSTMENTS
+  if (ws->state.calibration != 0 || ws->state.power != 0) {
+    fill_adjusted(ws, buffer, color, first, count);
+    mark_stale(ws, first, clamp_range(ws, first, count));
+    return;
+  }
+#endif /* WS2812B_PER_LED_ADJUSTMENTS */
+
+  uint8_t encoded[32];
+  encode_fixed_colors(ws, &color, 1, encoded);
+  fill_constant(ws, buffer, encoded, first, count);
+  mark_stale(ws, first, clamp_range(ws, first, count));
+}
+
+void ws2812b_set_blackout_frame(ws2812b_handle_t *ws, uint8_t *frame) {
+  ws->state.blackout = frame;
+
+  if (frame != 0) {
+    // All LEDs off, without any color adjustments.
+    uint8_t encoded[32];
+    uint8_t black[4] = {0, 0, 0, 0};
+    encode_colors(ws, black, channel_count(ws), encoded);
+    fill_constant(ws, frame, encoded, 0, ws->led_count);
+  }
+}
+
+void ws2812b_fill_blackout(ws2812b_handle_t *ws, uint8_t *buffer) {
+  if (ws->state.blackout != 0) {
+    uint32_t len = ws2812b_required_buffer_len(ws);
+    memcpy(buffer, ws->state.blackout, len);
+    clean_cache_range(ws, buffer, len);
+    return;
+  }
+
+  uint8_t encoded[32];
+  uint8_t black[4] = {0, 0, 0, 0};
+  encode_colors(ws, black, channel_count(ws), encoded);
+  fill_constant(ws, buffer, encoded, 0, ws->led_count);
+}
+
+void ws2812b_rotate_leds(ws2812b_handle_t *ws, uint8_t *buffer, uint32_t first, uint32_t count,
+                         int32_t shift) {
+  // Every LED occupies a slot of the same length in the buffer, so LEDs are moved without
+  // being encoded again.
+  count = clamp_range(ws, first, count);
+  if (count < 2) {
+    return;
+  }
+
+  int32_t k = shift % (int32_t)count;
+  if (k == 0) {
+    return;
+  }
+
+  uint8_t *data = buffer + ws->config.prefix_len;
+  rotate_slots(ws, data + first * data_len(ws, 1), count,
+               k > 0 ? (uint32_t)k : count + k);
+  moved_leds(ws, data, first, count);
+}
+
+void ws2812b_scroll_leds(ws2812b_handle_t *ws, uint8_t *buffer, uint32_t first, uint32_t count,
+                         int32_t shift, ws2812b_led_t fill) {
+  count = clamp_range(ws, first, count);
+  uint32_t k = shift >= 0 ? (uint32_t)shift : -(uint32_t)shift;
+  if (count == 0 || k == 0) {
+    return;
+  }
+
+  // LEDs that are scrolled in are set to the fill color.
+  if (k >= count) {
+    ws2812b_fill_solid(ws, buffer, fill, first, count);
+  } else {
+    uint32_t led_len = data_len(ws, 1);
+    uint8_t *data = buffer + ws->config.prefix_len;
+    uint8_t *range = data + first * led_len;
+    if (shift > 0) {
+      memmove(range + k * led_len, range, (count - k) * led_len);
+      ws2812b_fill_solid(ws, buffer, fill, first, k);
+    } else {
+      memmove(range, range + k * led_len, (count - k) * led_len);
+      ws2812b_fill_solid(ws, buffer, fill, first + count - k, k);
+    }
+    moved_leds(ws, data, shift > 0 ? first + k : first, count - k);
+  }
+}
+
+void ws2812b_mirror_leds(ws2812b_handle_t *ws, uint8_t *buffer, uint32_t first, uint32_t count) {
+  count = clamp_range(ws, first, count);
+  if (count < 2) {
+    return;
+  }
+
+  uint8_t *data = buffer + ws->config.prefix_len;
+  reverse_slots(ws, data + first * data_len(ws, 1), count);
+  moved_leds(ws, data, first, count);
+}
+
+void ws2812b_copy_leds(ws2812b_handle_t *ws, uint8_t *buffer, uint32_t dst_first,
+                       uint32_t src_first, uint32_t count) {
+  // Ranges may overlap.
+  count = clamp_range(ws, src_first, count);
+  count = clamp_range(ws, dst_first, count);
+  if (count == 0 || src_first == dst_first) {
+    return;
+  }
+
+  uint32_t led_len = data_len(ws, 1);
+  uint8_t *data = buffer + ws->config.prefix_len;
+  memmove(data + dst_first * led_len, data + src_first * led_len, count * led_len);
+  moved_leds(ws, data, dst_first, count);
+}
+
+void ws2812b_sync_leds(ws2812b_handle_t *ws, const uint8_t *buffer) {
+  // LEDs moved in the buffer are decoded back into the LED array. Decoded colors are the colors
+  // as sent, so this only restores the original colors if no color adjustments are enabled.
+  const uint8_t *data = buffer + ws->config.prefix_len;
+  uint32_t color_len = WS2812B_DATA_LEN(1, ws->config.packing) / 3;
+
+  if (ws->state.source != WS2812B_SOURCE_LEDS) {
+    ws->state.stale_first = 0;
+    ws->state.stale_end = 0;
+    return;
+  }
+
+  for (uint32_t i = ws->state.stale_first; i < ws->state.stale_end; i++) {
+    const uint8_t *led = data + 3 * i * color_len;
+    uint32_t index = i;
+#ifndef WS2812B_DISABLE_LAYOUTS
+    const ws2812b_layout_t *layout = ws->state.layout;
+    if (layout != 0 && layout->table != 0) {
+      index = layout->table[i];
+    } else if (layout != 0) {
+      int32_t step;
+      layout_run(layout, i, &index, &step);
+    }
+#endif /* WS2812B_DISABLE_LAYOUTS */
+    ws->leds[index].green = decode_color(ws, led);
+    ws->leds[index].red = decode_color(ws, led + color_len);
+    ws->leds[index].blue = decode_color(ws, led + 2 * color_len);
+  }
+
+  ws->state.stale_first = 0;
+  ws->state.stale_end = 0;
+}
+
+ws2812b_led_t *ws2812b_inplace_leds(ws2812b_handle_t *ws, uint8_t *buffer) {
+  // Place the LEDs at the very end of the buffer. Every LED is encoded into at least 12 bytes
+  // while only taking up 3, so the encoder (which works front-to-back) never reaches an LED
+  // before it was consumed. The suffix is only written after all LEDs have been encoded.
+  uint32_t buffer_len = ws2812b_required_buffer_len(ws);
+  ws->leds = (ws2812b_led_t *)(buffer + buffer_len - ws->led_count * sizeof(ws2812b_led_t));
+  return ws->leds;
+}
+
+void ws2812b_fill_data(ws2812b_handle_t *ws, uint8_t *data_buffer) {
+  encode_leds(ws, data_buffer);
+  clean_cache_range(ws, data_buffer, data_len(ws, ws->led_count));
+}
+
+uint32_t ws2812b_fill_segments(ws2812b_handle_t *ws, uint8_t *data_buffer,
+                               ws2812b_segment_t *segments) {
+  uint32_t count = 0;
+
+  // Prefix, pointing into shared zero block
+  count += add_zero_segments(ws->config.prefix_len, &segments[count]);
+
+  // Data, encoded into the caller's buffer
+  uint32_t len = data_len(ws, ws->led_count);
+  if (len != 0) {
+    ws2812b_fill_data(ws, data_buffer);
+    segments[count].ptr = data_buffer;
+    segments[count].len = len;
+    count++;
+  }
+
+  // Suffix, pointing into shared zero block
+  count += add_zero_segments(ws->config.suffix_len, &segments[count]);
+
+  return count;
 }
 
 void ws2812b_iter_restart(ws2812b_handle_t *ws) { ws->state.iteration_index = 0; }
@@ -149,8 +940,8 @@ bool ws2812b_iter_is_finished(ws2812b_handle_t *ws) {
   // so the iterator limit has to be calculated using single packing no matter
   // what is configued.
 
-  const uint32_t iteration_limit = WS2812B_REQUIRED_BUFFER_LEN(
-      ws->led_count, WS2812B_PACKING_SINGLE, ws->config.prefix_len, ws->config.suffix_len);
+  const uint32_t iteration_limit =
+      ws->config.prefix_len + iter_data_len(ws) + ws->config.suffix_len;
 
   return ws->state.iteration_index >= iteration_limit;
 }
@@ -162,7 +953,7 @@ uint8_t ws2812b_iter_next(ws2812b_handle_t *ws) {
 
   uint32_t prefix_len = ws->config.prefix_len;
   uint32_t suffix_len = ws->config.suffix_len;
-  uint32_t data_len = WS2812B_DATA_LEN(ws->led_count, WS2812B_PACKING_SINGLE);
+  uint32_t data_len = iter_data_len(ws);
 
   uint32_t i = ws->state.iteration_index;
 
@@ -173,48 +964,233 @@ uint8_t ws2812b_iter_next(ws2812b_handle_t *ws) {
 
   } else if (i < prefix_len + data_len) {
     // In data block
+    return iter_data_next(ws, i - prefix_len, &ws->state.iteration_index);
 
-    // Determined which LED, color and bit(s) should be sent:
-    uint32_t led = (i - prefix_len) / 24;
-
-    uint_fast8_t color = ((i - prefix_len) % 24) / 8;
+  } else if (i < prefix_len + data_len + suffix_len) {
+    // In suffix
+    ws->state.iteration_index++;
+    return 0x00;
+  }
 
-    uint_fast8_t bit = (i - prefix_len) % 8;
+  // Iteration finished, return 0
+  return 0x00;
+}
+
+uint32_t ws2812b_chain_required_buffer_len(ws2812b_handle_t **handles, uint32_t count) {
+  if (count == 0) {
+    return 0;
+  }
+
+  uint32_t len = handles[0]->config.prefix_len + handles[count - 1]->config.suffix_len;
+  for (uint32_t i = 0; i < count; i++) {
+    len += data_len(handles[i], handles[i]->led_count);
+  }
+
+  return len;
+}
+
+int ws2812b_fill_chain(ws2812b_handle_t **handles, uint32_t count, uint8_t *buffer) {
+  uint8_t *buffer_start = buffer;
+
+  if (count == 0) {
+    return 0;
+  }
+
+  if (check_chain(handles, count)) {
+    return -1;
+  }
+
+  // Add 0x00 prefix of first handle
+  for (uint32_t i = 0; i < handles[0]->config.prefix_len; i++) {
+    *buffer = 0x00;
+    buffer++;
+  }
+
+  // Encode every handle's LEDs back-to-back
+  for (uint32_t i = 0; i < count; i++) {
+    encode_leds(handles[i], buffer);
+    buffer += data_len(handles[i], handles[i]->led_count);
+  }
+
+  // Add 0x00 suffix of last handle
+  for (uint32_t i = 0; i < handles[count - 1]->config.suffix_len; i++) {
+    *buffer = 0x00;
+    buffer++;
+  }
+
+  // The whole frame is cleaned using the first handle's cache maintenance hook.
+  clean_cache_range(handles[0], buffer_start, buffer - buffer_start);
+
+  return 0;
+}
+
+int ws2812b_chain_iter_restart(ws2812b_chain_t *chain) {
+  chain->iteration_index = 0;
+  chain->handle_index = 0;
+  chain->data_offset = 0;
+
+  if (check_chain(chain->handles, chain->count)) {
+    // Nothing is sent: the iterator is finished right away.
+    chain->handle_index = chain->count;
+    chain->iteration_index = UINT32_MAX;
+    return -1;
+  }
+
+  chain_iter_skip_finished(chain);
+  return 0;
+}
+
+bool ws2812b_chain_iter_is_finished(ws2812b_chain_t *chain) {
+  if (chain->count == 0) {
+    return true;
+  }
+
+  if (chain->handle_index < chain->count) {
+    // Still in prefix or data block
+    return false;
+  }
+
+  // As with a single handle, the iteration index is handled as if in single packing mode.
+
+  const uint32_t iteration_limit = chain->handles[0]->config.prefix_len + chain->data_offset +
+                                   chain->handles[chain->count - 1]->config.suffix_len;
+
+  return chain->iteration_index >= iteration_limit;
+}
+
+uint8_t ws2812b_chain_iter_next(ws2812b_chain_t *chain) {
+  if (ws2812b_chain_iter_is_finished(chain)) {
+    // Iteration finished, return 0
+    return 0x00;
+  }
+
+  uint32_t prefix_len = chain->handles[0]->config.prefix_len;
+  uint32_t i = chain->iteration_index;
+
+  if (i < prefix_len || chain->handle_index >= chain->count) {
+    // In prefix or suffix
+    chain->iteration_index++;
+    return 0x00;
+  }
+
+  // In data block of current handle
+  ws2812b_handle_t *ws = chain->handles[chain->handle_index];
+  uint8_t result = iter_data_next(ws, i - prefix_len - chain->data_offset, &chain->iteration_index);
+  chain_iter_skip_finished(chain);
+
+  return result;
+}
+
+// ======== Private Functions ======================================================================
+
+static int init_pulses(ws2812b_handle_t *ws) {
+  // Assert packing is valid
+  WS2812B_INIT_ASSERT((ws->config.packing == WS2812B_PACKING_DOUBLE) ||
+                          (ws->config.packing == WS2812B_PACKING_SINGLE),
+                      "ws2812b: config.packing is invalid!");
+
+  // Assert pulse_len_1 is valid
+  WS2812B_INIT_ASSERT(WS2812B_IS_PULSE_LEN(ws->config.pulse_len_1),
+                      "ws2812b: config.pulse_len_1 is invalid!");
 
-    // Grab the current data byte in which the bit(s) that should
-    // be sent are located:
-    uint8_t data_byte;
-    if (color == 0) {
-      data_byte = ws->leds[led].green;
-    } else if (color == 1) {
-      data_byte = ws->leds[led].red;
+  // Asert pulse_len_0 is valid
+  WS2812B_INIT_ASSERT(WS2812B_IS_PULSE_LEN(ws->config.pulse_len_0),
+                      "ws2812b: config.pulse_len_0 is invalid!");
+
+  // Assert first_bit_0 is valid
+  WS2812B_INIT_ASSERT((ws->config.first_bit_0 == WS2812B_FIRST_BIT_0_DISABLED) ||
+                          (ws->config.first_bit_0 == WS2812B_FIRST_BIT_0_ENABLED),
+                      "ws2812b: config.first_bit_0 is invalid!");
+
+  // Assert spi_bit_order is valid
+  WS2812B_INIT_ASSERT((ws->config.spi_bit_order == WS2812B_LSB_FIRST) ||
+                          (ws->config.spi_bit_order == WS2812B_MSB_FIRST),
+                      "ws2812b: config.spi_bit_order is invalid!");
+
+  // Assert that the '1' pulse is longer than the '0' pulse:
+  WS2812B_INIT_ASSERT(ws->config.pulse_len_1 > ws->config.pulse_len_0,
+                      "ws2812b: One-pulse must be longer than zero-pulse!");
+
+  // Assert that pulse is not too long if in double packing:
+  if (ws->config.packing == WS2812B_PACKING_DOUBLE) {
+    WS2812B_INIT_ASSERT(ws->config.pulse_len_1 < WS2812B_PULSE_LEN_4b,
+                        "ws2812b: Pulse is too long for double packing!");
+  }
+
+  // Apply 0 prefix to pulse if selected
+  ws->state.pulse_0 = ws->config.pulse_len_0 << ws->config.first_bit_0;
+  ws->state.pulse_1 = ws->config.pulse_len_1 << ws->config.first_bit_0;
+
+  // Pulse needs to be reverse for MSB-first transmission:
+  if (ws->config.spi_bit_order == WS2812B_MSB_FIRST) {
+    if (ws->config.packing == WS2812B_PACKING_DOUBLE) {
+      ws->state.pulse_0 = WS2812B_NIBBLE_REVERSE(ws->state.pulse_0);
+      ws->state.pulse_1 = WS2812B_NIBBLE_REVERSE(ws->state.pulse_1);
     } else {
-      data_byte = ws->leds[led].blue;
+      ws->state.pulse_0 = WS2812B_BYTE_REVERSE(ws->state.pulse_0);
+      ws->state.pulse_1 = WS2812B_BYTE_REVERSE(ws->state.pulse_1);
     }
+  }
 
-    uint8_t result;
+  return 0;
+}
+
+static void build_retarget_table(ws2812b_handle_t *ws, uint8_t old_pulse_0, uint8_t old_pulse_1,
+                                 ws2812b_order_t old_order, uint8_t *table) {
+  for (uint32_t x = 0; x < 256; x++) {
     if (ws->config.packing == WS2812B_PACKING_SINGLE) {
-      // Single packing
-      result = construct_single_pulse(ws, bit, data_byte);
-      ws->state.iteration_index += 1;
-    } else {
-      // Double packing
-      result = construct_double_pulse(ws, bit, data_byte);
-      ws->state.iteration_index += 2;
+      table[x] = retarget_pulse(ws, old_pulse_0, old_pulse_1, x);
+      continue;
     }
 
-    return result;
-  } else if (i < prefix_len + data_len + suffix_len) {
-    // In suffix
-    ws->state.iteration_index++;
-    return 0x00;
+    // The nibble sent first depends on the bit order (see construct_double_pulse), so the
+    // nibbles swap places if the bit order changes.
+    uint8_t low = retarget_pulse(ws, old_pulse_0, old_pulse_1, x & 0x0F);
+    uint8_t high = retarget_pulse(ws, old_pulse_0, old_pulse_1, x >> 4);
+    if (old_order != ws->config.spi_bit_order) {
+      table[x] = low << 4 | high;
+    } else {
+      table[x] = high << 4 | low;
+    }
   }
+}
 
-  // Iteration finished, return 0
-  return 0x00;
+static uint8_t retarget_pulse(ws2812b_handle_t *ws, uint8_t old_pulse_0, uint8_t old_pulse_1,
+                              uint8_t pulse) {
+  if (pulse == old_pulse_1) {
+    return ws->state.pulse_1;
+  } else if (pulse == old_pulse_0) {
+    return ws->state.pulse_0;
+  }
+  return pulse;
 }
 
-// ======== Private Functions ======================================================================
+static void retarget_range(const uint8_t *table, const uint8_t *pulses, uint32_t pulse_count,
+                           uint8_t *data, uint32_t len) {
+  uint32_t i = 0;
+
+#ifdef WS2812B_SIMD_SSE2
+  // SSE2 has no byte table lookup, but only the bytes in pulses can occur, so every one of them
+  // is compared and replaced: 16 bytes per step.
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)&data[i]);
+    __m128i out = v;
+    for (uint32_t p = 0; p < pulse_count; p++) {
+      __m128i match = _mm_cmpeq_epi8(v, _mm_set1_epi8((char)pulses[p]));
+      __m128i replaced = _mm_set1_epi8((char)table[pulses[p]]);
+      out = _mm_or_si128(_mm_and_si128(match, replaced), _mm_andnot_si128(match, out));
+    }
+    _mm_storeu_si128((__m128i *)&data[i], out);
+  }
+#else
+  (void)pulses;
+  (void)pulse_count;
+#endif /* WS2812B_SIMD_SSE2 */
+
+  for (; i < len; i++) {
+    data[i] = table[data[i]];
+  }
+}
 
 static void set_init_error_msg(const char *error_msg) {
 #ifndef WS2812B_DISABLE_ERROR_MSG
@@ -235,6 +1211,19 @@ static void set_init_error_msg(const char *error_msg) {
 #endif /* WS2812B_DISABLE_ERROR_MSG */
 }
 
+static void clean_cache_range(ws2812b_handle_t *ws, uint8_t *start, uint32_t len) {
+  if (ws->state.clean_range == 0 || len == 0) {
+    return;
+  }
+
+  // Extend range to full cache lines
+  uintptr_t mask = ws->state.cache_line_len - 1;
+  uintptr_t first = (uintptr_t)start & ~mask;
+  uintptr_t end = ((uintptr_t)start + len + mask) & ~mask;
+
+  ws->state.clean_range((void *)first, end - first);
+}
+
 static void add_byte(ws2812b_handle_t *ws, uint8_t value, uint8_t **buffer) {
   if (ws->config.packing == WS2812B_PACKING_DOUBLE) {
 
@@ -252,6 +1241,1653 @@ static void add_byte(ws2812b_handle_t *ws, uint8_t value, uint8_t **buffer) {
   }
 }
 
+static void encode_leds(ws2812b_handle_t *ws, uint8_t *data_buffer) {
+#ifndef WS2812B_DISABLE_PALETTE
+  if (palette_encoded(ws) != 0) {
+    encode_leds_palette(ws, data_buffer);
+    return;
+  }
+#endif /* WS2812B_DISABLE_PALETTE */
+
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+  power_frame_start(ws, data_buffer);
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+
+#ifdef WS2812B_STREAMING_STORES
+  if (data_len(ws, ws->led_count) >= WS2812B_STREAMING_THRESHOLD) {
+    encode_leds_streaming(ws, data_buffer);
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+    power_frame_end(ws, data_buffer);
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+    return;
+  }
+#endif /* WS2812B_STREAMING_STORES */
+
+  // LEDs are loaded and encoded in blocks, so that sources can convert several LEDs at once.
+  // Note: LEDs have to be encoded front-to-back, as the LEDs may be located in the
+  // same buffer (see ws2812b_inplace_leds). A whole block is loaded before it is written.
+  uint8_t *dst = data_buffer;
+
+  for (uint32_t i = 0; i < ws->led_count; i += WS2812B_BLOCK_LEN) {
+    uint32_t count = ws->led_count - i < WS2812B_BLOCK_LEN ? ws->led_count - i : WS2812B_BLOCK_LEN;
+    encode_range(ws, i, count, dst);
+    dst += data_len(ws, count);
+  }
+
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+  power_frame_end(ws, data_buffer);
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+}
+
+static void encode_fixed_colors(ws2812b_handle_t *ws, const ws2812b_led_t *leds, uint32_t count,
+                                uint8_t *dst) {
+  // Encodes colors that are not bound to an LED or a frame (palette entries, solid fills), with
+  // the color matrix and curves applied.
+  uint8_t colors[WS2812B_BLOCK_LEN * 4];
+
+  for (uint32_t i = 0; i < count; i += WS2812B_BLOCK_LEN) {
+    uint32_t block = count - i < WS2812B_BLOCK_LEN ? count - i : WS2812B_BLOCK_LEN;
+    for (uint32_t j = 0; j < block; j++) {
+      colors[3 * j + 0] = leds[i + j].green;
+      colors[3 * j + 1] = leds[i + j].red;
+      colors[3 * j + 2] = leds[i + j].blue;
+    }
+
+#ifndef WS2812B_DISABLE_CORRECTION
+    if (ws->state.color_matrix != 0) {
+      apply_color_matrix(ws->state.color_matrix, block, colors);
+    }
+#endif /* WS2812B_DISABLE_CORRECTION */
+#ifndef WS2812B_DISABLE_CURVES
+    apply_curves(ws, block, colors);
+#endif /* WS2812B_DISABLE_CURVES */
+
+#ifndef WS2812B_DISABLE_PIXELS
+    if (ws->state.source == WS2812B_SOURCE_PIXELS) {
+      to_wire_order(ws->state.pixel_format, block, colors, 0);
+    }
+#endif /* WS2812B_DISABLE_PIXELS */
+
+    encode_colors(ws, colors, block * channel_count(ws), dst);
+    dst += data_len(ws, block);
+  }
+}
+
+static void fill_constant(ws2812b_handle_t *ws, uint8_t *buffer, const uint8_t *encoded,
+                          uint32_t first, uint32_t count) {
+  // Sets LEDs first..first+count-1 to an encoded color, and writes the prefix and suffix.
+  // Other LEDs are left as they are.
+  uint32_t led_len = data_len(ws, 1);
+  uint8_t *data = buffer + ws->config.prefix_len;
+  uint8_t *suffix = data + data_len(ws, ws->led_count);
+
+  first = first < ws->led_count ? first : ws->led_count;
+  count = count < ws->led_count - first ? count : ws->led_count - first;
+
+  memset(buffer, 0x00, ws->config.prefix_len);
+  memset(suffix, 0x00, ws->config.suffix_len);
+
+  if (count != 0) {
+    uint8_t *dst = data + first * led_len;
+    memcpy(dst, encoded, led_len);
+    replicate(dst, led_len, count * led_len);
+  }
+
+  // Prefix, LEDs and suffix are cleaned with one call, so that shared cache lines are cleaned
+  // only once.
+  clean_cache_range(ws, buffer, suffix + ws->config.suffix_len - buffer);
+}
+
+#ifdef WS2812B_PER_LED_ADJUSTMENTS
+
+static void fill_adjusted(ws2812b_handle_t *ws, uint8_t *buffer, ws2812b_led_t color,
+                          uint32_t first, uint32_t count) {
+  // Sets LEDs first..first+count-1 to a color with all adjustments applied, and writes the prefix
+  // and suffix. A fill of all LEDs is accounted as a frame by the power limit, partial fills are
+  // limited with the current scale.
+  uint32_t led_len = data_len(ws, 1);
+  uint8_t *data = buffer + ws->config.prefix_len;
+  uint8_t *suffix = data + data_len(ws, ws->led_count);
+  uint8_t colors[WS2812B_BLOCK_LEN * 4];
+
+  first = first < ws->led_count ? first : ws->led_count;
+  count = clamp_range(ws, first, count);
+
+  memset(buffer, 0x00, ws->config.prefix_len);
+  memset(suffix, 0x00, ws->config.suffix_len);
+
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+  bool frame = first == 0 && count == ws->led_count;
+  if (frame) {
+    power_frame_start(ws, data);
+  }
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+
+  for (uint32_t i = 0; i < count; i += WS2812B_BLOCK_LEN) {
+    uint32_t block = count - i < WS2812B_BLOCK_LEN ? count - i : WS2812B_BLOCK_LEN;
+    for (uint32_t j = 0; j < block; j++) {
+      colors[3 * j + 0] = color.green;
+      colors[3 * j + 1] = color.red;
+      colors[3 * j + 2] = color.blue;
+    }
+
+#ifndef WS2812B_DISABLE_CORRECTION
+    if (ws->state.color_matrix != 0) {
+      apply_color_matrix(ws->state.color_matrix, block, colors);
+    }
+    if (ws->state.calibration != 0) {
+      apply_calibration(&ws->state.calibration[first + i], block, colors);
+    }
+#endif /* WS2812B_DISABLE_CORRECTION */
+#ifndef WS2812B_DISABLE_CURVES
+    apply_curves(ws, block, colors);
+#endif /* WS2812B_DISABLE_CURVES */
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+    if (ws->state.power != 0) {
+      apply_power_limit(ws->state.power, block, colors, 0);
+    }
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+
+    // The white channel of 4-channel pixels is off.
+#ifndef WS2812B_DISABLE_PIXELS
+    if (ws->state.source == WS2812B_SOURCE_PIXELS) {
+      to_wire_order(ws->state.pixel_format, block, colors, 0);
+    }
+#endif /* WS2812B_DISABLE_PIXELS */
+
+    encode_colors(ws, colors, block * channel_count(ws), data + (first + i) * led_len);
+  }
+
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+  if (frame) {
+    power_frame_end(ws, data);
+  }
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+
+  clean_cache_range(ws, buffer, suffix + ws->config.suffix_len - buffer);
+}
+
+#endif /* WS2812B_PER_LED_ADJUSTMENTS */
+
+static void replicate(uint8_t *dst, uint32_t len, uint32_t total_len) {
+  // Repeats the first len bytes of dst up to total_len. The copied range doubles with every
+  // step, so only log2(total_len / len) copies are needed.
+  while (len < total_len) {
+    uint32_t n = len < total_len - len ? len : total_len - len;
+    memcpy(dst + len, dst, n);
+    len += n;
+  }
+}
+
+static uint32_t clamp_range(ws2812b_handle_t *ws, uint32_t first, uint32_t count) {
+  // Number of LEDs of first..first+count-1 that exist.
+  if (first >= ws->led_count) {
+    return 0;
+  }
+  return count < ws->led_count - first ? count : ws->led_count - first;
+}
+
+static void rotate_slots(ws2812b_handle_t *ws, uint8_t *data, uint32_t count, uint32_t shift) {
+  // Moves every LED slot from i to (i + shift) % count.
+  uint32_t led_len = data_len(ws, 1);
+  uint32_t back = count - shift;
+
+  if (shift <= WS2812B_BLOCK_LEN || back <= WS2812B_BLOCK_LEN) {
+    // The LEDs that wrap around are set aside, and the others moved with a single memmove.
+    uint8_t wrapped[WS2812B_BLOCK_LEN * 32];
+    if (shift <= back) {
+      memcpy(wrapped, data + back * led_len, shift * led_len);
+      memmove(data + shift * led_len, data, back * led_len);
+      memcpy(data, wrapped, shift * led_len);
+    } else {
+      memcpy(wrapped, data, back * led_len);
+      memmove(data, data + back * led_len, shift * led_len);
+      memcpy(data + shift * led_len, wrapped, back * led_len);
+    }
+    return;
+  }
+
+  // Otherwise by three reversals: AB -> reverse(B)reverse(A) -> BA
+  reverse_slots(ws, data, count);
+  reverse_slots(ws, data, shift);
+  reverse_slots(ws, data + shift * led_len, back);
+}
+
+static void reverse_slots(ws2812b_handle_t *ws, uint8_t *data, uint32_t count) {
+  uint32_t led_len = data_len(ws, 1);
+  uint8_t tmp[32];
+
+  for (uint32_t i = 0; i < count / 2; i++) {
+    uint8_t *a = data + i * led_len;
+    uint8_t *b = data + (count - 1 - i) * led_len;
+    memcpy(tmp, a, led_len);
+    memcpy(a, b, led_len);
+    memcpy(b, tmp, led_len);
+  }
+}
+
+static void moved_leds(ws2812b_handle_t *ws, uint8_t *data, uint32_t first, uint32_t count) {
+  // Cleans the moved LEDs, which are now out of sync with the LED array.
+  uint32_t led_len = data_len(ws, 1);
+  clean_cache_range(ws, data + first * led_len, count * led_len);
+  mark_stale(ws, first, count);
+}
+
+static void mark_stale(ws2812b_handle_t *ws, uint32_t first, uint32_t count) {
+  // Adds LEDs to the range that is out of sync with the LED array, see ws2812b_sync_leds.
+  if (count == 0) {
+    return;
+  }
+
+  if (ws->state.stale_first == ws->state.stale_end) {
+    ws->state.stale_first = first;
+    ws->state.stale_end = first + count;
+  } else {
+    uint32_t end = first + count;
+    ws->state.stale_first = first < ws->state.stale_first ? first : ws->state.stale_first;
+    ws->state.stale_end = end > ws->state.stale_end ? end : ws->state.stale_end;
+  }
+}
+
+static void load_colors(ws2812b_handle_t *ws, uint32_t first, uint32_t count, uint8_t *colors) {
+  // Loads the colors of LEDs first..first+count-1, in output order (G, R, B, or as set by the
+  // pixel format). Color adjustments are applied to G, R, B before the pixel format's order.
+  uint8_t white[WS2812B_BLOCK_LEN];
+
+  switch (ws->state.source) {
+#ifndef WS2812B_DISABLE_LED16
+  case WS2812B_SOURCE_LED16:
+    load_colors_led16(ws, first, count, colors);
+    break;
+#endif /* WS2812B_DISABLE_LED16 */
+
+#ifndef WS2812B_DISABLE_FLOAT
+  case WS2812B_SOURCE_FLOAT:
+    load_colors_float(ws, first, count, colors);
+    break;
+#endif /* WS2812B_DISABLE_FLOAT */
+
+#ifndef WS2812B_DISABLE_HSV
+  case WS2812B_SOURCE_HSV_SPECTRUM:
+  case WS2812B_SOURCE_HSV_RAINBOW:
+    load_colors_hsv(ws, first, count, colors);
+    break;
+#endif /* WS2812B_DISABLE_HSV */
+
+#ifndef WS2812B_DISABLE_PALETTE
+  case WS2812B_SOURCE_PALETTE:
+    load_colors_palette(ws, first, count, colors);
+    break;
+#endif /* WS2812B_DISABLE_PALETTE */
+
+#ifndef WS2812B_DISABLE_PIXELS
+  case WS2812B_SOURCE_PIXELS:
+    load_colors_pixels(ws, first, count, colors, white);
+    break;
+#endif /* WS2812B_DISABLE_PIXELS */
+
+#ifndef WS2812B_DISABLE_PLANAR
+  case WS2812B_SOURCE_PLANAR:
+    load_colors_planar(ws, first, count, colors);
+    break;
+#endif /* WS2812B_DISABLE_PLANAR */
+
+#ifndef WS2812B_DISABLE_RGB565
+  case WS2812B_SOURCE_RGB565:
+    load_colors_rgb565(ws, first, count, colors);
+    break;
+
+  case WS2812B_SOURCE_RGB444:
+    load_colors_rgb444(ws, first, count, colors);
+    break;
+#endif /* WS2812B_DISABLE_RGB565 */
+
+#ifndef WS2812B_DISABLE_SHADER
+  case WS2812B_SOURCE_SHADER:
+    load_colors_shader(ws, first, count, colors);
+    break;
+#endif /* WS2812B_DISABLE_SHADER */
+
+  default:
+    load_colors_leds(ws, first, count, colors);
+    break;
+  }
+
+#ifndef WS2812B_DISABLE_CORRECTION
+  if (ws->state.color_matrix != 0) {
+    apply_color_matrix(ws->state.color_matrix, count, colors);
+  }
+
+  if (ws->state.calibration != 0) {
+    apply_calibration(&ws->state.calibration[first], count, colors);
+  }
+#endif /* WS2812B_DISABLE_CORRECTION */
+
+#ifndef WS2812B_DISABLE_CURVES
+  if (!expand_merged(ws)) {
+    apply_curves(ws, count, colors);
+  }
+#endif /* WS2812B_DISABLE_CURVES */
+
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+  if (ws->state.power != 0) {
+    bool has_white = channel_count(ws) == 4;
+    apply_power_limit(ws->state.power, count, colors, has_white ? white : 0);
+  }
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+
+#ifndef WS2812B_DISABLE_PIXELS
+  if (ws->state.source == WS2812B_SOURCE_PIXELS) {
+    to_wire_order(ws->state.pixel_format, count, colors, white);
+  }
+#endif /* WS2812B_DISABLE_PIXELS */
+
+  (void)white; // Unused without pixels and the power limit.
+}
+
+static void load_colors_leds(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                             uint8_t *colors) {
+#ifndef WS2812B_DISABLE_LAYOUTS
+  if (ws->state.layout != 0) {
+    load_colors_layout(ws, first, count, colors);
+    return;
+  }
+#endif /* WS2812B_DISABLE_LAYOUTS */
+
+  const ws2812b_led_t *led = &ws->leds[first];
+  for (uint32_t i = 0; i < count; i++) {
+    colors[3 * i + 0] = led[i].green;
+    colors[3 * i + 1] = led[i].red;
+    colors[3 * i + 2] = led[i].blue;
+  }
+}
+
+#ifndef WS2812B_DISABLE_LAYOUTS
+
+static void load_colors_layout(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                               uint8_t *colors) {
+  // Gathers LEDs from the framebuffer in chain order. LEDs further ahead are prefetched wherever
+  // the gather does not walk through memory in order.
+  const ws2812b_layout_t *layout = ws->state.layout;
+  const ws2812b_led_t *leds = ws->leds;
+
+  if (layout->table != 0) {
+    const uint32_t *table = layout->table;
+    for (uint32_t i = 0; i < count; i++) {
+      if (first + i + WS2812B_LAYOUT_PREFETCH < ws->led_count) {
+        WS2812B_PREFETCH(&leds[table[first + i + WS2812B_LAYOUT_PREFETCH]]);
+      }
+      const ws2812b_led_t *led = &leds[table[first + i]];
+      colors[3 * i + 0] = led->green;
+      colors[3 * i + 1] = led->red;
+      colors[3 * i + 2] = led->blue;
+    }
+    return;
+  }
+
+  // Along a row (column) of a panel, the framebuffer index changes by a constant step, so the
+  // mapping is only worked out once per row (column).
+  for (uint32_t i = 0; i < count;) {
+    uint32_t index;
+    int32_t step;
+    uint32_t run = layout_run(layout, first + i, &index, &step);
+    run = run < count - i ? run : count - i;
+    bool prefetch = step != 1 && step != -1;
+
+    for (uint32_t j = 0; j < run; j++, i++) {
+      if (prefetch && j + WS2812B_LAYOUT_PREFETCH < run) {
+        WS2812B_PREFETCH(&leds[index + WS2812B_LAYOUT_PREFETCH * step]);
+      }
+      const ws2812b_led_t *led = &leds[index];
+      colors[3 * i + 0] = led->green;
+      colors[3 * i + 1] = led->red;
+      colors[3 * i + 2] = led->blue;
+      index += step;
+    }
+  }
+}
+
+static uint32_t layout_run(const ws2812b_layout_t *layout, uint32_t led, uint32_t *index,
+                           int32_t *step) {
+  // Framebuffer index of an LED, the step to the next LED and the number of LEDs left in the
+  // row (column) of the panel it is in, including itself.
+  uint32_t tile_width = layout->tile_width;
+  uint32_t tile_height = layout->tile_height;
+  uint32_t width = tile_width * layout->tiles_x;
+
+  uint32_t tile = led / (tile_width * tile_height);
+  uint32_t in_tile = led % (tile_width * tile_height);
+  uint32_t tile_row = tile / layout->tiles_x;
+  uint32_t tile_col = tile % layout->tiles_x;
+  if ((layout->flags & WS2812B_LAYOUT_TILES_SERPENTINE) && tile_row % 2 == 1) {
+    tile_col = layout->tiles_x - 1 - tile_col;
+  }
+
+  bool columns = layout->flags & WS2812B_LAYOUT_COLUMNS;
+  uint32_t line_len = columns ? tile_height : tile_width;
+  uint32_t line = in_tile / line_len;
+  uint32_t pos = in_tile % line_len;
+  bool reverse = (layout->flags & WS2812B_LAYOUT_SERPENTINE) && line % 2 == 1;
+  uint32_t along = reverse ? line_len - 1 - pos : pos;
+
+  uint32_t x = tile_col * tile_width + (columns ? line : along);
+  uint32_t y = tile_row * tile_height + (columns ? along : line);
+  *index = y * width + x;
+  *step = (int32_t)(columns ? width : 1);
+  *step = reverse ? -*step : *step;
+
+  return line_len - pos;
+}
+
+#endif /* WS2812B_DISABLE_LAYOUTS */
+
+#ifndef WS2812B_DISABLE_LED16
+
+static void load_colors_led16(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                              uint8_t *colors) {
+  // Temporal dithering: The part of every value that does not fit into 8 bits is carried over
+  // to the next frame, so that the average over several frames matches the 16-bit value.
+  const ws2812b_led16_t *led = (const ws2812b_led16_t *)ws->state.source_data + first;
+  ws2812b_led_t *error = ws->state.source_state;
+  uint32_t i = 0;
+
+  if (error == 0) {
+    // Without error accumulators, values are rounded.
+    for (; i < count; i++) {
+      colors[3 * i + 0] = (led[i].green > 0xFF7F ? 0xFF00 : led[i].green + 0x80) >> 8;
+      colors[3 * i + 1] = (led[i].red > 0xFF7F ? 0xFF00 : led[i].red + 0x80) >> 8;
+      colors[3 * i + 2] = (led[i].blue > 0xFF7F ? 0xFF00 : led[i].blue + 0x80) >> 8;
+    }
+    return;
+  }
+
+  error += first;
+
+#ifdef WS2812B_SIMD_SSE2
+  // 16 LEDs (48 values) at a time, with the same saturating arithmetic as below.
+  if (count == WS2812B_BLOCK_LEN) {
+    uint8_t rgb[48];
+    for (uint32_t v = 0; v < 3; v++) {
+      __m128i e = _mm_loadu_si128((const __m128i *)((uint8_t *)error + 16 * v));
+      __m128i lo = _mm_loadu_si128((const __m128i *)((const uint16_t *)led + 16 * v));
+      __m128i hi = _mm_loadu_si128((const __m128i *)((const uint16_t *)led + 16 * v + 8));
+      lo = _mm_adds_epu16(lo, _mm_unpacklo_epi8(e, _mm_setzero_si128()));
+      hi = _mm_adds_epu16(hi, _mm_unpackhi_epi8(e, _mm_setzero_si128()));
+      __m128i mask = _mm_set1_epi16(0xFF);
+      __m128i q = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+      e = _mm_packus_epi16(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+      _mm_storeu_si128((__m128i *)((uint8_t *)error + 16 * v), e);
+      _mm_storeu_si128((__m128i *)&rgb[16 * v], q);
+    }
+    for (; i < count; i++) {
+      colors[3 * i + 0] = rgb[3 * i + 1];
+      colors[3 * i + 1] = rgb[3 * i + 0];
+      colors[3 * i + 2] = rgb[3 * i + 2];
+    }
+    return;
+  }
+#endif /* WS2812B_SIMD_SSE2 */
+
+  for (; i < count; i++) {
+    colors[3 * i + 0] = dither(led[i].green, &error[i].green);
+    colors[3 * i + 1] = dither(led[i].red, &error[i].red);
+    colors[3 * i + 2] = dither(led[i].blue, &error[i].blue);
+  }
+}
+
+static uint8_t dither(uint16_t value, uint8_t *error) {
+  uint32_t sum = value + *error;
+  if (sum > 0xFFFF) {
+    sum = 0xFFFF;
+  }
+  *error = sum & 0xFF;
+  return sum >> 8;
+}
+
+#endif /* WS2812B_DISABLE_LED16 */
+
+#ifndef WS2812B_DISABLE_FLOAT
+
+static void load_colors_float(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                              uint8_t *colors) {
+  // Every value is clamped to [0, 1] and scaled to an index into the transfer curve (or directly
+  // to 0..255 if linear), then rounded. Float NaNs are treated as 0. Half-float infinities and
+  // NaNs are converted to large finite values, and saturate.
+  const ws2812b_float_source_t *source = ws->state.source_data;
+  const void *channels[3] = {source->green, source->red, source->blue};
+  const uint8_t *transfer = source->transfer;
+  float scale = transfer != 0 ? WS2812B_TRANSFER_CURVE_LEN - 1 : 255;
+
+  for (uint32_t c = 0; c < 3; c++) {
+    int32_t index[WS2812B_BLOCK_LEN];
+    uint32_t i = 0;
+
+#ifdef WS2812B_SIMD_SSE2
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 scale_v = _mm_set1_ps(scale);
+    __m128 half_v = _mm_set1_ps(0.5f);
+
+    for (; i + 4 <= count; i += 4) {
+      uint32_t led = first + i;
+      __m128 v;
+
+      if (source->format == WS2812B_FLOAT_F16) {
+        // Half to float: Shift exponent and mantissa into place, and rebias the exponent with a
+        // multiplication, which also handles subnormals. Values are clamped below, so the sign
+        // only needs to survive as far as the comparison with 0.
+        const uint16_t *h = (const uint16_t *)channels[c] + led * source->stride;
+        __m128i bits = _mm_setr_epi32(h[0], h[source->stride], h[2 * source->stride],
+                                      h[3 * source->stride]);
+        __m128i sign = _mm_slli_epi32(_mm_and_si128(bits, _mm_set1_epi32(0x8000)), 16);
+        __m128i magnitude = _mm_slli_epi32(_mm_and_si128(bits, _mm_set1_epi32(0x7FFF)), 13);
+        v = _mm_mul_ps(_mm_castsi128_ps(magnitude), _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+        v = _mm_or_ps(v, _mm_castsi128_ps(sign));
+      } else if (source->stride == 1) {
+        v = _mm_loadu_ps((const float *)channels[c] + led);
+      } else {
+        const float *f = (const float *)channels[c] + led * source->stride;
+        v = _mm_setr_ps(f[0], f[source->stride], f[2 * source->stride], f[3 * source->stride]);
+      }
+
+      // max returns its second operand if the first is NaN.
+      v = _mm_min_ps(_mm_max_ps(v, zero), one);
+      v = _mm_add_ps(_mm_mul_ps(v, scale_v), half_v);
+      _mm_storeu_si128((__m128i *)&index[i], _mm_cvttps_epi32(v));
+    }
+#endif /* WS2812B_SIMD_SSE2 */
+
+    for (; i < count; i++) {
+      float v = load_float(source, channels[c], first + i);
+      v = v > 0.0f ? v : 0.0f;
+      v = v < 1.0f ? v : 1.0f;
+      index[i] = (int32_t)(v * scale + 0.5f);
+    }
+
+    if (transfer != 0) {
+      for (i = 0; i < count; i++) {
+        colors[3 * i + c] = transfer[index[i]];
+      }
+    } else {
+      for (i = 0; i < count; i++) {
+        colors[3 * i + c] = index[i];
+      }
+    }
+  }
+}
+
+static float load_float(const ws2812b_float_source_t *source, const void *channel, uint32_t i) {
+  if (source->format == WS2812B_FLOAT_F16) {
+    return half_to_float(((const uint16_t *)channel)[i * source->stride]);
+  }
+  return ((const float *)channel)[i * source->stride];
+}
+
+static float half_to_float(uint16_t half) {
+  // Same conversion as the SIMD path: Exponent and mantissa are shifted into place, and the
+  // exponent is rebiased by multiplying with 2^112, which also handles subnormals.
+  uint32_t bits = (uint32_t)(half & 0x7FFF) << 13;
+  float magnitude;
+  memcpy(&magnitude, &bits, sizeof(magnitude));
+  magnitude *= 5.192296858534828e33f; // 2^112
+  return (half & 0x8000) ? -magnitude : magnitude;
+}
+
+#endif /* WS2812B_DISABLE_FLOAT */
+
+#ifndef WS2812B_DISABLE_HSV
+
+static void load_colors_hsv(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                            uint8_t *colors) {
+  // Integer conversion: The hue selects a sector and an offset within it, which give the fully
+  // saturated color. Saturation then blends towards white, and value scales the result. Both
+  // scale by (x + 1) / 256, so that 255 leaves a channel unchanged.
+  const ws2812b_hsv_t *led = (const ws2812b_hsv_t *)ws->state.source_data + first;
+  bool rainbow = ws->state.source == WS2812B_SOURCE_HSV_RAINBOW;
+  const hsv_table_t *table = rainbow ? &hsv_rainbow : &hsv_spectrum;
+  uint32_t i = 0;
+
+  // Output order (G, R, B) to table order (R, G, B)
+  static const uint8_t channels[3] = {1, 0, 2};
+
+#ifdef WS2812B_SIMD_SSE2
+  // 8 LEDs at a time, in 16-bit lanes. Table entries are selected by comparing with every sector.
+  for (; i + 8 <= count; i += 8) {
+    const ws2812b_hsv_t *l = &led[i];
+    __m128i hue = _mm_setr_epi16(l[0].hue, l[1].hue, l[2].hue, l[3].hue, l[4].hue, l[5].hue,
+                                 l[6].hue, l[7].hue);
+    __m128i sat = _mm_setr_epi16(l[0].saturation, l[1].saturation, l[2].saturation,
+                                 l[3].saturation, l[4].saturation, l[5].saturation,
+                                 l[6].saturation, l[7].saturation);
+    __m128i val = _mm_setr_epi16(l[0].value, l[1].value, l[2].value, l[3].value, l[4].value,
+                                 l[5].value, l[6].value, l[7].value);
+    __m128i sector, offset;
+    if (rainbow) {
+      sector = _mm_srli_epi16(hue, 5);
+      offset = _mm_slli_epi16(_mm_and_si128(hue, _mm_set1_epi16(31)), 3);
+    } else {
+      __m128i hue6 = _mm_mullo_epi16(hue, _mm_set1_epi16(6));
+      sector = _mm_srli_epi16(hue6, 8);
+      offset = _mm_and_si128(hue6, _mm_set1_epi16(0xFF));
+    }
+    __m128i sat_scale = _mm_add_epi16(sat, _mm_set1_epi16(1));
+    __m128i white = _mm_sub_epi16(_mm_set1_epi16(255), sat);
+    __m128i val_scale = _mm_add_epi16(val, _mm_set1_epi16(1));
+
+    for (uint32_t c = 0; c < 3; c++) {
+      uint32_t ch = channels[c];
+      __m128i base = _mm_setzero_si128();
+      __m128i rise = _mm_setzero_si128();
+      __m128i fall = _mm_setzero_si128();
+      for (uint32_t s = 0; s < 8; s++) {
+        __m128i in_sector = _mm_cmpeq_epi16(sector, _mm_set1_epi16(s));
+        base = _mm_or_si128(base, _mm_and_si128(in_sector, _mm_set1_epi16(table->base[s][ch])));
+        rise = _mm_or_si128(rise, _mm_and_si128(in_sector, _mm_set1_epi16(table->rise[s][ch])));
+        fall = _mm_or_si128(fall, _mm_and_si128(in_sector, _mm_set1_epi16(table->fall[s][ch])));
+      }
+
+      __m128i v = _mm_add_epi16(base, _mm_srli_epi16(_mm_mullo_epi16(rise, offset), 8));
+      v = _mm_sub_epi16(v, _mm_srli_epi16(_mm_mullo_epi16(fall, offset), 8));
+      v = _mm_add_epi16(_mm_srli_epi16(_mm_mullo_epi16(v, sat_scale), 8), white);
+      v = _mm_srli_epi16(_mm_mullo_epi16(v, val_scale), 8);
+
+      uint16_t out[8];
+      _mm_storeu_si128((__m128i *)out, v);
+      for (uint32_t j = 0; j < 8; j++) {
+        colors[3 * (i + j) + c] = out[j];
+      }
+    }
+  }
+#endif /* WS2812B_SIMD_SSE2 */
+
+  for (; i < count; i++) {
+    uint32_t sector, offset;
+    if (rainbow) {
+      sector = led[i].hue >> 5;
+      offset = (led[i].hue & 31) << 3;
+    } else {
+      sector = (led[i].hue * 6) >> 8;
+      offset = (led[i].hue * 6) & 0xFF;
+    }
+
+    for (uint32_t c = 0; c < 3; c++) {
+      uint32_t ch = channels[c];
+      uint32_t v = table->base[sector][ch] + ((table->rise[sector][ch] * offset) >> 8) -
+                   ((table->fall[sector][ch] * offset) >> 8);
+      v = ((v * (led[i].saturation + 1)) >> 8) + 255 - led[i].saturation;
+      v = (v * (led[i].value + 1)) >> 8;
+      colors[3 * i + c] = v;
+    }
+  }
+}
+
+#endif /* WS2812B_DISABLE_HSV */
+
+#ifndef WS2812B_DISABLE_PALETTE
+
+static void load_colors_palette(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                                uint8_t *colors) {
+  const ws2812b_palette_t *palette = ws->state.source_data;
+  for (uint32_t i = 0; i < count; i++) {
+    const ws2812b_led_t *led = &palette->colors[palette_index(palette, first + i)];
+    colors[3 * i + 0] = led->green;
+    colors[3 * i + 1] = led->red;
+    colors[3 * i + 2] = led->blue;
+  }
+}
+
+#endif /* WS2812B_DISABLE_PALETTE */
+
+#ifndef WS2812B_DISABLE_PIXELS
+
+static void load_colors_pixels(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                               uint8_t *colors, uint8_t *white) {
+  // The format is read once per block, so that the loops only index with locals. The white
+  // channel is gathered separately, as color adjustments only apply to G, R, B.
+  const ws2812b_pixel_format_t *format = ws->state.pixel_format;
+  uint32_t stride = format->stride;
+  const uint8_t *pixel = (const uint8_t *)ws->state.source_data + first * stride;
+  const uint8_t *green = pixel + format->offsets[WS2812B_CHANNEL_GREEN];
+  const uint8_t *red = pixel + format->offsets[WS2812B_CHANNEL_RED];
+  const uint8_t *blue = pixel + format->offsets[WS2812B_CHANNEL_BLUE];
+
+  for (uint32_t i = 0; i < count; i++) {
+    colors[3 * i + 0] = green[i * stride];
+    colors[3 * i + 1] = red[i * stride];
+    colors[3 * i + 2] = blue[i * stride];
+  }
+
+  if (format->channels == 4) {
+    const uint8_t *w = pixel + format->offsets[WS2812B_CHANNEL_WHITE];
+    for (uint32_t i = 0; i < count; i++) {
+      white[i] = w[i * stride];
+    }
+  }
+}
+
+#endif /* WS2812B_DISABLE_PIXELS */
+
+#ifndef WS2812B_DISABLE_PLANAR
+
+static void load_colors_planar(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                               uint8_t *colors) {
+  const ws2812b_planar_t *planes = ws->state.source_data;
+  for (uint32_t i = 0; i < count; i++) {
+    colors[3 * i + 0] = planes->green[first + i];
+    colors[3 * i + 1] = planes->red[first + i];
+    colors[3 * i + 2] = planes->blue[first + i];
+  }
+}
+
+static bool planar_direct(ws2812b_handle_t *ws) {
+  // Planes are encoded directly unless an adjustment that mixes channels or depends on the LED
+  // or frame is enabled. Color curves are applied by the planar encoder.
+  return ws->state.source == WS2812B_SOURCE_PLANAR && ws->state.color_matrix == 0 &&
+         ws->state.calibration == 0 && ws->state.power == 0;
+}
+
+#endif /* WS2812B_DISABLE_PLANAR */
+
+#ifndef WS2812B_DISABLE_RGB565
+
+static void load_colors_rgb565(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                               uint8_t *colors) {
+  const uint16_t *leds = (const uint16_t *)ws->state.source_data + first;
+  const uint8_t *red, *green, *blue;
+  expand_tables(ws, &red, &green, &blue);
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint16_t led = leds[i];
+    colors[3 * i + 0] = green[(led >> 5) & 0x3F];
+    colors[3 * i + 1] = red[led >> 11];
+    colors[3 * i + 2] = blue[led & 0x1F];
+  }
+}
+
+static void load_colors_rgb444(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                               uint8_t *colors) {
+  // Two LEDs take up 3 bytes: R0 G0 | B0 R1 | G1 B1.
+  const uint8_t *leds = ws->state.source_data;
+  const uint8_t *red, *green, *blue;
+  expand_tables(ws, &red, &green, &blue);
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t index = first + i;
+    const uint8_t *led = &leds[3 * index / 2];
+    if (index % 2 == 0) {
+      colors[3 * i + 0] = green[led[0] & 0x0F];
+      colors[3 * i + 1] = red[led[0] >> 4];
+      colors[3 * i + 2] = blue[led[1] >> 4];
+    } else {
+      colors[3 * i + 0] = green[led[1] >> 4];
+      colors[3 * i + 1] = red[led[0] & 0x0F];
+      colors[3 * i + 2] = blue[led[1] & 0x0F];
+    }
+  }
+}
+
+#endif /* WS2812B_DISABLE_RGB565 */
+
+#ifndef WS2812B_DISABLE_SHADER
+
+static void load_colors_shader(ws2812b_handle_t *ws, uint32_t first, uint32_t count,
+                               uint8_t *colors) {
+  // Colors are requested as they are encoded: A whole block per call from batched shaders, a
+  // single LED from the iterator.
+  const ws2812b_shader_t *shader = ws->state.source_data;
+  ws2812b_led_t leds[WS2812B_SHADER_BATCH_LEN];
+
+  for (uint32_t i = 0; i < count; i += WS2812B_SHADER_BATCH_LEN) {
+    uint32_t batch = count - i < WS2812B_SHADER_BATCH_LEN ? count - i : WS2812B_SHADER_BATCH_LEN;
+    if (shader->colors_at != 0) {
+      shader->colors_at(first + i, batch, leds, shader->ctx);
+    } else {
+      for (uint32_t j = 0; j < batch; j++) {
+        leds[j] = shader->color_at(first + i + j, shader->ctx);
+      }
+    }
+
+    for (uint32_t j = 0; j < batch; j++) {
+      colors[3 * (i + j) + 0] = leds[j].green;
+      colors[3 * (i + j) + 1] = leds[j].red;
+      colors[3 * (i + j) + 2] = leds[j].blue;
+    }
+  }
+}
+
+#endif /* WS2812B_DISABLE_SHADER */
+
+#ifndef WS2812B_DISABLE_RGB565
+
+static void expand_tables(ws2812b_handle_t *ws, const uint8_t **red, const uint8_t **green,
+                          const uint8_t **blue) {
+  const ws2812b_expand_tables_t *tables = ws->state.source_state;
+  if (tables != 0) {
+    *red = tables->red;
+    *green = tables->green;
+    *blue = tables->blue;
+  } else if (ws->state.source == WS2812B_SOURCE_RGB565) {
+    *red = expand_5;
+    *green = expand_6;
+    *blue = expand_5;
+  } else {
+    *red = *green = *blue = expand_4;
+  }
+}
+
+#endif /* WS2812B_DISABLE_RGB565 */
+
+#ifndef WS2812B_DISABLE_CURVES
+
+static bool expand_merged(ws2812b_handle_t *ws) {
+  // The color curves are merged into the caller's expansion tables, unless the color matrix or
+  // calibration has to be applied between expansion and curves.
+  return (ws->state.source == WS2812B_SOURCE_RGB565 || ws->state.source == WS2812B_SOURCE_RGB444) &&
+         ws->state.source_state != 0 && curves_enabled(ws) && ws->state.color_matrix == 0 &&
+         ws->state.calibration == 0;
+}
+
+#endif /* WS2812B_DISABLE_CURVES */
+
+#ifndef WS2812B_DISABLE_PLANAR
+
+static void encode_planar(ws2812b_handle_t *ws, uint32_t first, uint32_t count, uint8_t *dst) {
+  // Encodes LEDs first..first+count-1 straight from the planes, without interleaving them first.
+  const ws2812b_planar_t *planes = ws->state.source_data;
+  const uint8_t *src[3] = {planes->green + first, planes->red + first, planes->blue + first};
+  const uint8_t *curves[3] = {ws->state.curves[WS2812B_CHANNEL_GREEN],
+                              ws->state.curves[WS2812B_CHANNEL_RED],
+                              ws->state.curves[WS2812B_CHANNEL_BLUE]};
+  uint32_t color_len = WS2812B_DATA_LEN(1, ws->config.packing) / 3;
+  uint32_t i = 0;
+
+#ifdef WS2812B_SIMD_SSE2
+  // 16 LEDs per step. Blocks start at a multiple of WS2812B_BLOCK_LEN (16), so the loads are
+  // aligned.
+  for (; i + 16 <= count; i += 16) {
+    __m128i values[3];
+    for (uint32_t c = 0; c < 3; c++) {
+      if (curves[c] != 0) {
+        uint8_t curved[16];
+        for (uint32_t j = 0; j < 16; j++) {
+          curved[j] = curves[c][src[c][i + j]];
+        }
+        values[c] = _mm_loadu_si128((const __m128i *)curved);
+      } else {
+        values[c] = _mm_load_si128((const __m128i *)&src[c][i]);
+      }
+    }
+    encode_planes_16(ws, values, dst + 3 * i * color_len);
+  }
+#endif /* WS2812B_SIMD_SSE2 */
+
+  dst += 3 * i * color_len;
+  for (; i < count; i++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      uint8_t value = src[c][i];
+      add_byte(ws, curves[c] != 0 ? curves[c][value] : value, &dst);
+    }
+  }
+}
+
+#ifdef WS2812B_SIMD_SSE2
+static void encode_planes_16(ws2812b_handle_t *ws, const __m128i *values, uint8_t *dst) {
+  // Encodes 16 LEDs from their G, R and B values. Every bit (pair) is turned into pulses for all
+  // 16 LEDs at once (one vector per bit), the vectors are transposed into the pulses of each
+  // LED, and the three colors are interleaved again so that only full 16-byte stores are used.
+  // Bits are tested through the sign of each byte, shifting the values left after every bit,
+  // and pulses are selected as pulse_0 ^ (bit & (pulse_0 ^ pulse_1)).
+  __m128i zero = _mm_setzero_si128();
+  __m128i pulse_0 = _mm_set1_epi8((char)ws->state.pulse_0);
+  __m128i diff = _mm_set1_epi8((char)(ws->state.pulse_0 ^ ws->state.pulse_1));
+
+  if (ws->config.packing == WS2812B_PACKING_SINGLE) {
+    // leds[c][k]: All 8 pulses of color c of LEDs 2k and 2k+1.
+    __m128i leds[3][8];
+    for (uint32_t c = 0; c < 3; c++) {
+      __m128i v = values[c];
+      __m128i p[8];
+      for (uint32_t b = 0; b < 8; b++) {
+        p[b] = _mm_xor_si128(pulse_0, _mm_and_si128(_mm_cmplt_epi8(v, zero), diff));
+        v = _mm_add_epi8(v, v);
+      }
+
+      // 8x16 transpose. a[2b + h]: Bits 2b, 2b+1 of LEDs 8h..8h+7.
+      __m128i a[8];
+      for (uint32_t b = 0; b < 8; b += 2) {
+        a[b] = _mm_unpacklo_epi8(p[b], p[b + 1]);
+        a[b + 1] = _mm_unpackhi_epi8(p[b], p[b + 1]);
+      }
+      // q[2h + k]: Bits 0-3 and 4-7 of LEDs 8h + 4k..8h + 4k + 3.
+      for (uint32_t h = 0; h < 2; h++) {
+        __m128i lo_0_3 = _mm_unpacklo_epi16(a[h], a[h + 2]);
+        __m128i hi_0_3 = _mm_unpackhi_epi16(a[h], a[h + 2]);
+        __m128i lo_4_7 = _mm_unpacklo_epi16(a[h + 4], a[h + 6]);
+        __m128i hi_4_7 = _mm_unpackhi_epi16(a[h + 4], a[h + 6]);
+        leds[c][4 * h + 0] = _mm_unpacklo_epi32(lo_0_3, lo_4_7);
+        leds[c][4 * h + 1] = _mm_unpackhi_epi32(lo_0_3, lo_4_7);
+        leds[c][4 * h + 2] = _mm_unpacklo_epi32(hi_0_3, hi_4_7);
+        leds[c][4 * h + 3] = _mm_unpackhi_epi32(hi_0_3, hi_4_7);
+      }
+    }
+
+    // Two LEDs (G R B G R B) per three stores.
+    for (uint32_t k = 0; k < 8; k++) {
+      __m128i g = leds[0][k], r = leds[1][k], b = leds[2][k];
+      __m128i b_g = _mm_castpd_si128(_mm_shuffle_pd(_mm_castsi128_pd(b), _mm_castsi128_pd(g), 2));
+      _mm_storeu_si128((__m128i *)(dst + 48 * k), _mm_unpacklo_epi64(g, r));
+      _mm_storeu_si128((__m128i *)(dst + 48 * k + 16), b_g);
+      _mm_storeu_si128((__m128i *)(dst + 48 * k + 32), _mm_unpackhi_epi64(r, b));
+    }
+    return;
+  }
+
+  // Double packing: The low nibble holds the pulse sent first, see construct_double_pulse.
+  // Bit 2b of every pair goes into the high nibble if MSB-first, into the low one otherwise.
+  bool msb_first = ws->config.spi_bit_order == WS2812B_MSB_FIRST;
+  __m128i diff_even = msb_first ? _mm_slli_epi16(diff, 4) : diff;
+  __m128i diff_odd = msb_first ? diff : _mm_slli_epi16(diff, 4);
+  pulse_0 = _mm_or_si128(pulse_0, _mm_slli_epi16(pulse_0, 4));
+
+  // leds[c][k]: All 4 bytes of color c of LEDs 4k..4k+3.
+  __m128i leds[3][4];
+  for (uint32_t c = 0; c < 3; c++) {
+    __m128i v = values[c];
+    __m128i p[4];
+    for (uint32_t b = 0; b < 4; b++) {
+      __m128i even = _mm_and_si128(_mm_cmplt_epi8(v, zero), diff_even);
+      v = _mm_add_epi8(v, v);
+      __m128i odd = _mm_and_si128(_mm_cmplt_epi8(v, zero), diff_odd);
+      v = _mm_add_epi8(v, v);
+      p[b] = _mm_xor_si128(pulse_0, _mm_or_si128(even, odd));
+    }
+
+    // 4x16 transpose
+    __m128i a0 = _mm_unpacklo_epi8(p[0], p[1]);
+    __m128i a1 = _mm_unpackhi_epi8(p[0], p[1]);
+    __m128i a2 = _mm_unpacklo_epi8(p[2], p[3]);
+    __m128i a3 = _mm_unpackhi_epi8(p[2], p[3]);
+    leds[c][0] = _mm_unpacklo_epi16(a0, a2);
+    leds[c][1] = _mm_unpackhi_epi16(a0, a2);
+    leds[c][2] = _mm_unpacklo_epi16(a1, a3);
+    leds[c][3] = _mm_unpackhi_epi16(a1, a3);
+  }
+
+  // Four LEDs (G0 R0 B0 G1 | R1 B1 G2 R2 | B2 G3 R3 B3) per three stores.
+  for (uint32_t k = 0; k < 4; k++) {
+    __m128i g = leds[0][k], r = leds[1][k], b = leds[2][k];
+    __m128i g_next = _mm_srli_si128(g, 4);
+    __m128i g0_r0 = _mm_unpacklo_epi32(g, r);
+    __m128i b0_g1 = _mm_unpacklo_epi32(b, g_next);
+    __m128i r1_b1 = _mm_unpacklo_epi32(_mm_srli_si128(r, 4), _mm_srli_si128(b, 4));
+    __m128i g2_r2 = _mm_unpackhi_epi32(g, r);
+    __m128i b2_g3 = _mm_unpackhi_epi32(b, g_next);
+    __m128i r3_b3 = _mm_unpackhi_epi32(r, b);
+    __m128i last =
+        _mm_castpd_si128(_mm_shuffle_pd(_mm_castsi128_pd(b2_g3), _mm_castsi128_pd(r3_b3), 2));
+    _mm_storeu_si128((__m128i *)(dst + 48 * k), _mm_unpacklo_epi64(g0_r0, b0_g1));
+    _mm_storeu_si128((__m128i *)(dst + 48 * k + 16), _mm_unpacklo_epi64(r1_b1, g2_r2));
+    _mm_storeu_si128((__m128i *)(dst + 48 * k + 32), last);
+  }
+}
+#endif /* WS2812B_SIMD_SSE2 */
+
+#endif /* WS2812B_DISABLE_PLANAR */
+
+#ifndef WS2812B_DISABLE_PIXELS
+
+static void to_wire_order(const ws2812b_pixel_format_t *format, uint32_t count, uint8_t *colors,
+                          const uint8_t *white) {
+  // Rearranges G, R, B colors (and white, or 0 if white is 0) into the order in which the
+  // channels are sent. Pixels are widened back-to-front, so that every pixel is read before
+  // it is overwritten.
+  uint32_t channels = format->channels;
+  if (channels == 3 && format->order[0] == WS2812B_CHANNEL_GREEN &&
+      format->order[1] == WS2812B_CHANNEL_RED && format->order[2] == WS2812B_CHANNEL_BLUE) {
+    return;
+  }
+
+  // Position of each channel (R, G, B, W) within the loaded colors.
+  static const uint8_t loaded[4] = {1, 0, 2, 3};
+  uint8_t order[4];
+  for (uint32_t c = 0; c < channels; c++) {
+    order[c] = loaded[format->order[c]];
+  }
+
+  for (uint32_t i = count; i-- > 0;) {
+    uint8_t pixel[4] = {colors[3 * i], colors[3 * i + 1], colors[3 * i + 2], 0};
+    pixel[3] = white != 0 ? white[i] : 0;
+    for (uint32_t c = 0; c < channels; c++) {
+      colors[channels * i + c] = pixel[order[c]];
+    }
+  }
+}
+
+#endif /* WS2812B_DISABLE_PIXELS */
+
+static uint32_t channel_count(ws2812b_handle_t *ws) {
+  return ws->state.source == WS2812B_SOURCE_PIXELS ? ws->state.pixel_format->channels : 3;
+}
+
+static uint32_t data_len(ws2812b_handle_t *ws, uint32_t led_count) {
+  return WS2812B_PIXEL_DATA_LEN(led_count, channel_count(ws), ws->config.packing);
+}
+
+static uint32_t iter_data_len(ws2812b_handle_t *ws) {
+  // The iterator index is always handled as if in single packing mode.
+  return WS2812B_PIXEL_DATA_LEN(ws->led_count, channel_count(ws), WS2812B_PACKING_SINGLE);
+}
+
+#ifndef WS2812B_DISABLE_PALETTE
+
+static uint32_t palette_index(const ws2812b_palette_t *palette, uint32_t led) {
+  if (palette->bits == 8) {
+    return palette->indices[led];
+  }
+  return (palette->indices[led / 2] >> (led % 2 == 0 ? 4 : 0)) & 0x0F;
+}
+
+static const uint8_t *palette_encoded(ws2812b_handle_t *ws) {
+  // The encoded palette entries can be used as they are unless a per-LED or per-frame
+  // adjustment is enabled.
+  if (ws->state.source != WS2812B_SOURCE_PALETTE || ws->state.calibration != 0 ||
+      ws->state.power != 0) {
+    return 0;
+  }
+  return ((const ws2812b_palette_t *)ws->state.source_data)->encoded;
+}
+
+static void encode_leds_palette(ws2812b_handle_t *ws, uint8_t *data_buffer) {
+  // Every LED is a copy of its encoded palette entry. The lengths are constant in each loop, so
+  // that the copies are inlined.
+  const ws2812b_palette_t *palette = ws->state.source_data;
+  const uint8_t *encoded = palette->encoded;
+
+  if (ws->config.packing == WS2812B_PACKING_SINGLE) {
+    for (uint32_t i = 0; i < ws->led_count; i++) {
+      memcpy(&data_buffer[24 * i], &encoded[24 * palette_index(palette, i)], 24);
+    }
+  } else {
+    for (uint32_t i = 0; i < ws->led_count; i++) {
+      memcpy(&data_buffer[12 * i], &encoded[12 * palette_index(palette, i)], 12);
+    }
+  }
+}
+
+#endif /* WS2812B_DISABLE_PALETTE */
+
+#ifndef WS2812B_DISABLE_CORRECTION
+
+static void apply_color_matrix(const ws2812b_color_matrix_t *matrix, uint32_t count,
+                               uint8_t *colors) {
+  // Colors are in output order (G, R, B), the matrix in R, G, B order.
+  static const uint8_t channels[3] = {1, 0, 2};
+  uint32_t i = 0;
+
+#ifdef WS2812B_SIMD_SSE2
+  // 8 LEDs at a time. Pairs of 16-bit products are summed into 32 bits by madd, with the
+  // rounding constant paired with blue. Results are clamped to 0..255 by saturating packs.
+  for (; i + 8 <= count; i += 8) {
+    uint8_t *c8 = &colors[3 * i];
+    __m128i green = _mm_setr_epi16(c8[0], c8[3], c8[6], c8[9], c8[12], c8[15], c8[18], c8[21]);
+    __m128i red = _mm_setr_epi16(c8[1], c8[4], c8[7], c8[10], c8[13], c8[16], c8[19], c8[22]);
+    __m128i blue = _mm_setr_epi16(c8[2], c8[5], c8[8], c8[11], c8[14], c8[17], c8[20], c8[23]);
+    __m128i one = _mm_set1_epi16(1);
+
+    __m128i rg_lo = _mm_unpacklo_epi16(red, green);
+    __m128i rg_hi = _mm_unpackhi_epi16(red, green);
+    __m128i b1_lo = _mm_unpacklo_epi16(blue, one);
+    __m128i b1_hi = _mm_unpackhi_epi16(blue, one);
+
+    uint8_t out[3][16];
+    for (uint32_t c = 0; c < 3; c++) {
+      const int16_t *row = matrix->m[channels[c]];
+      __m128i m_rg = _mm_set1_epi32((uint16_t)row[0] | (uint32_t)(uint16_t)row[1] << 16);
+      __m128i m_b1 = _mm_set1_epi32((uint16_t)row[2] | (uint32_t)2048 << 16);
+      __m128i lo = _mm_add_epi32(_mm_madd_epi16(rg_lo, m_rg), _mm_madd_epi16(b1_lo, m_b1));
+      __m128i hi = _mm_add_epi32(_mm_madd_epi16(rg_hi, m_rg), _mm_madd_epi16(b1_hi, m_b1));
+      __m128i v = _mm_packs_epi32(_mm_srai_epi32(lo, 12), _mm_srai_epi32(hi, 12));
+      _mm_storeu_si128((__m128i *)out[c], _mm_packus_epi16(v, v));
+    }
+
+    for (uint32_t j = 0; j < 8; j++) {
+      c8[3 * j + 0] = out[0][j];
+      c8[3 * j + 1] = out[1][j];
+      c8[3 * j + 2] = out[2][j];
+    }
+  }
+#endif /* WS2812B_SIMD_SSE2 */
+
+  for (; i < count; i++) {
+    int32_t rgb[3] = {colors[3 * i + 1], colors[3 * i + 0], colors[3 * i + 2]};
+    for (uint32_t c = 0; c < 3; c++) {
+      const int16_t *row = matrix->m[channels[c]];
+      int32_t v = row[0] * rgb[0] + row[1] * rgb[1] + row[2] * rgb[2] + 2048;
+      v = v < 0 ? 0 : v >> 12;
+      colors[3 * i + c] = v > 255 ? 255 : v;
+    }
+  }
+}
+
+#endif /* WS2812B_DISABLE_CORRECTION */
+
+#ifndef WS2812B_DISABLE_CURVES
+
+static void apply_curves(ws2812b_handle_t *ws, uint32_t count, uint8_t *colors) {
+  // Colors are in output order (G, R, B).
+  const uint8_t *curves[3] = {ws->state.curves[WS2812B_CHANNEL_GREEN],
+                              ws->state.curves[WS2812B_CHANNEL_RED],
+                              ws->state.curves[WS2812B_CHANNEL_BLUE]};
+  for (uint32_t c = 0; c < 3; c++) {
+    if (curves[c] == 0) {
+      continue;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      colors[3 * i + c] = curves[c][colors[3 * i + c]];
+    }
+  }
+}
+
+static bool curves_enabled(ws2812b_handle_t *ws) {
+  return ws->state.curves[0] != 0 || ws->state.curves[1] != 0 || ws->state.curves[2] != 0;
+}
+
+#endif /* WS2812B_DISABLE_CURVES */
+
+#ifndef WS2812B_DISABLE_CORRECTION
+
+static void apply_calibration(const ws2812b_gain_t *gains, uint32_t count, uint8_t *colors) {
+  // Gains are reordered to output order (G, R, B), so that colors and gains line up.
+  uint8_t scale[WS2812B_BLOCK_LEN * 3];
+  for (uint32_t i = 0; i < count; i++) {
+    scale[3 * i + 0] = gains[i].green;
+    scale[3 * i + 1] = gains[i].red;
+    scale[3 * i + 2] = gains[i].blue;
+  }
+
+  uint32_t i = 0;
+
+#ifdef WS2812B_SIMD_SSE2
+  // 16 values at a time, multiplied in 16-bit lanes.
+  __m128i zero = _mm_setzero_si128();
+  __m128i one = _mm_set1_epi16(1);
+  for (; i + 16 <= count * 3; i += 16) {
+    __m128i c = _mm_loadu_si128((const __m128i *)&colors[i]);
+    __m128i g = _mm_loadu_si128((const __m128i *)&scale[i]);
+    __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(c, zero),
+                                 _mm_add_epi16(_mm_unpacklo_epi8(g, zero), one));
+    __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(c, zero),
+                                 _mm_add_epi16(_mm_unpackhi_epi8(g, zero), one));
+    c = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+    _mm_storeu_si128((__m128i *)&colors[i], c);
+  }
+#endif /* WS2812B_SIMD_SSE2 */
+
+  for (; i < count * 3; i++) {
+    colors[i] = (colors[i] * (scale[i] + 1)) >> 8;
+  }
+}
+
+#endif /* WS2812B_DISABLE_CORRECTION */
+
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+
+static void apply_power_limit(ws2812b_power_t *power, uint32_t count, uint8_t *colors,
+                              uint8_t *white) {
+  // Channels are summed before limiting, to estimate the current the frame would draw. white is
+  // the white channel of 4-channel pixels, or 0 if there is none.
+  uint32_t sums[3] = {0, 0, 0};
+  for (uint32_t i = 0; i < count; i++) {
+    sums[0] += colors[3 * i + 0];
+    sums[1] += colors[3 * i + 1];
+    sums[2] += colors[3 * i + 2];
+  }
+  power->sums[WS2812B_CHANNEL_GREEN] += sums[0];
+  power->sums[WS2812B_CHANNEL_RED] += sums[1];
+  power->sums[WS2812B_CHANNEL_BLUE] += sums[2];
+
+  if (power->scale < 256) {
+    for (uint32_t i = 0; i < count * 3; i++) {
+      colors[i] = (colors[i] * power->scale) >> 8;
+    }
+  }
+
+  if (white != 0) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      sum += white[i];
+      white[i] = (white[i] * power->scale) >> 8;
+    }
+    power->sums[WS2812B_CHANNEL_WHITE] += sum;
+  }
+}
+
+static void power_frame_start(ws2812b_handle_t *ws, uint8_t *data_buffer) {
+  ws2812b_power_t *power = ws->state.power;
+  if (power == 0) {
+    return;
+  }
+
+  power->sums[0] = power->sums[1] = power->sums[2] = power->sums[3] = 0;
+
+  // Frames that can be re-encoded are encoded without limit first.
+  if (power->mode == WS2812B_POWER_REENCODE && data_buffer != 0) {
+    power->scale = 256;
+  }
+}
+
+static void power_frame_end(ws2812b_handle_t *ws, uint8_t *data_buffer) {
+  ws2812b_power_t *power = ws->state.power;
+  if (power == 0) {
+    return;
+  }
+
+  // Estimated current: Idle current of all LEDs, plus every channel in proportion to its value.
+  uint64_t idle_ua = (uint64_t)power->idle_ua * ws->led_count;
+  uint64_t active_ua = 0;
+  for (uint32_t c = 0; c < channel_count(ws); c++) {
+    active_ua += power->sums[c] * power->channel_ua[c];
+  }
+  active_ua /= 255;
+
+  uint32_t frame_scale = power->scale;
+  power->requested_ma = (idle_ua + active_ua) / 1000;
+  power->frames++;
+
+  // Scale for the next frame (or this one, if re-encoded), so that the active current fits into
+  // what the idle current leaves of the budget.
+  uint64_t budget_ua = (uint64_t)power->budget_ma * 1000;
+  uint32_t scale = 256;
+  if (idle_ua + active_ua > budget_ua) {
+    scale = budget_ua > idle_ua ? (budget_ua - idle_ua) * 256 / active_ua : 0;
+  }
+
+  if (power->mode == WS2812B_POWER_REENCODE && data_buffer != 0 && scale < 256) {
+    scale_encoded(ws, data_buffer, scale);
+    frame_scale = scale;
+  }
+
+  if (frame_scale < 256) {
+    power->limited++;
+  }
+  power->output_ma = (idle_ua + active_ua * frame_scale / 256) / 1000;
+  power->scale = scale;
+}
+
+static void scale_encoded(ws2812b_handle_t *ws, uint8_t *data_buffer, uint32_t scale) {
+  // Decodes every color from its pulses, scales it and encodes it again. This does not need
+  // the LEDs, which may already be overwritten (in-place) or advanced (dithering).
+  uint32_t color_len = WS2812B_DATA_LEN(1, ws->config.packing) / 3;
+  uint32_t color_count = ws->led_count * channel_count(ws);
+  uint8_t colors[WS2812B_BLOCK_LEN * 3];
+
+  for (uint32_t i = 0; i < color_count; i += WS2812B_BLOCK_LEN * 3) {
+    uint32_t count = color_count - i;
+    count = count < WS2812B_BLOCK_LEN * 3 ? count : WS2812B_BLOCK_LEN * 3;
+    uint8_t *dst = data_buffer + i * color_len;
+    for (uint32_t c = 0; c < count; c++) {
+      colors[c] = (decode_color(ws, dst + c * color_len) * scale) >> 8;
+    }
+    encode_colors(ws, colors, count, dst);
+  }
+}
+
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+
+static uint8_t decode_color(ws2812b_handle_t *ws, const uint8_t *src) {
+  uint8_t value = 0;
+
+  if (ws->config.packing == WS2812B_PACKING_SINGLE) {
+    for (uint_fast8_t b = 0; b < 8; b++) {
+      value |= src[b] == ws->state.pulse_1 ? 0x80U >> b : 0;
+    }
+    return value;
+  }
+
+  // Double packing: The low nibble holds the second bit of each pair if MSB-first
+  // (see construct_double_pulse).
+  bool msb_first = ws->config.spi_bit_order == WS2812B_MSB_FIRST;
+  for (uint_fast8_t b = 0; b < 8; b += 2) {
+    uint8_t low = *src & 0x0F;
+    uint8_t high = *src >> 4;
+    src++;
+    value |= (msb_first ? high : low) == ws->state.pulse_1 ? 0x80U >> b : 0;
+    value |= (msb_first ? low : high) == ws->state.pulse_1 ? 0x80U >> (b + 1) : 0;
+  }
+  return value;
+}
+
+#if !defined(WS2812B_DISABLE_CURVES) || !defined(WS2812B_DISABLE_FLOAT)
+
+static void generate_curve(uint8_t *curve, uint32_t len, float gamma, uint8_t brightness) {
+  for (uint32_t i = 0; i < len; i++) {
+    curve[i] = (uint8_t)(curve_pow(i / (float)(len - 1), gamma) * brightness + 0.5f);
+  }
+}
+
+static float curve_pow(float x, float gamma) {
+  // x^gamma for x in [0, 1], computed as 2^(gamma * log2(x)) so that the driver does not depend
+  // on libm.
+  if (x <= 0.0f) {
+    return gamma > 0.0f ? 0.0f : 1.0f;
+  }
+
+  // log2(x): x = m * 2^e with m in [0.75, 1.5), and ln(m) = 2 * atanh((m - 1) / (m + 1)).
+  const float ln_2 = 0.69314718f;
+  int32_t e = 0;
+  while (x < 0.75f) {
+    x *= 2.0f;
+    e--;
+  }
+  float t = (x - 1.0f) / (x + 1.0f);
+  float term = t;
+  float ln_m = 0.0f;
+  for (uint32_t k = 1; k < 16; k += 2) {
+    ln_m += term / k;
+    term *= t * t;
+  }
+  float y = gamma * (e + 2.0f * ln_m / ln_2);
+
+  // 2^y: y = n + f with f in [0, 1), and 2^f = e^(f * ln(2)) from its Taylor series.
+  int32_t n = (int32_t)y;
+  n -= n > y ? 1 : 0;
+  float f = (y - n) * ln_2;
+  float result = 1.0f;
+  term = 1.0f;
+  for (uint32_t k = 1; k < 12; k++) {
+    term *= f / k;
+    result += term;
+  }
+  for (; n < 0 && result != 0.0f; n++) {
+    result *= 0.5f;
+  }
+  for (; n > 0; n--) {
+    result *= 2.0f;
+  }
+  return result;
+}
+
+#endif
+
+static void encode_colors(ws2812b_handle_t *ws, const uint8_t *colors, uint32_t count,
+                          uint8_t *dst) {
+#ifdef WS2812B_SIMD_SSE2
+  // Every bit (pair) of a color is selected with a mask, and turned into a pulse by comparing
+  // the result with the mask: 16 pulse bytes per step.
+  __m128i pulse_1 = _mm_set1_epi8((char)ws->state.pulse_1);
+  __m128i pulse_0 = _mm_set1_epi8((char)ws->state.pulse_0);
+
+  if (ws->config.packing == WS2812B_PACKING_SINGLE) {
+    __m128i mask = _mm_setr_epi8((char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, (char)0x80,
+                                 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+    for (; count >= 2; count -= 2) {
+      __m128i v =
+          _mm_unpacklo_epi64(_mm_set1_epi8((char)colors[0]), _mm_set1_epi8((char)colors[1]));
+      __m128i bit = _mm_cmpeq_epi8(_mm_and_si128(v, mask), mask);
+      __m128i out = _mm_or_si128(_mm_and_si128(bit, pulse_1), _mm_andnot_si128(bit, pulse_0));
+      _mm_storeu_si128((__m128i *)dst, out);
+      colors += 2;
+      dst += 16;
+    }
+
+  } else {
+    // The low nibble holds the pulse sent first: The lower bit of each pair if MSB-first.
+    __m128i mask_first = _mm_set1_epi32(0x01041040);
+    __m128i mask_second = _mm_set1_epi32(0x02082080);
+    if (ws->config.spi_bit_order == WS2812B_LSB_FIRST) {
+      __m128i tmp = mask_first;
+      mask_first = mask_second;
+      mask_second = tmp;
+    }
+    __m128i pulse_1_high = _mm_slli_epi16(pulse_1, 4);
+    __m128i pulse_0_high = _mm_slli_epi16(pulse_0, 4);
+
+    for (; count >= 4; count -= 4) {
+      __m128i v = _mm_setr_epi32(colors[0] * 0x01010101u, colors[1] * 0x01010101u,
+                                 colors[2] * 0x01010101u, colors[3] * 0x01010101u);
+      __m128i first = _mm_cmpeq_epi8(_mm_and_si128(v, mask_first), mask_first);
+      __m128i second = _mm_cmpeq_epi8(_mm_and_si128(v, mask_second), mask_second);
+      __m128i out = _mm_or_si128(_mm_and_si128(first, pulse_1), _mm_andnot_si128(first, pulse_0));
+      out = _mm_or_si128(out, _mm_or_si128(_mm_and_si128(second, pulse_1_high),
+                                           _mm_andnot_si128(second, pulse_0_high)));
+      _mm_storeu_si128((__m128i *)dst, out);
+      colors += 4;
+      dst += 16;
+    }
+  }
+#endif /* WS2812B_SIMD_SSE2 */
+
+  for (uint32_t i = 0; i < count; i++) {
+    add_byte(ws, colors[i], &dst);
+  }
+}
+
+static void encode_block(ws2812b_handle_t *ws, const uint8_t *colors, uint32_t count,
+                         uint8_t *dst) {
+  // Cache entries hold 3-channel LEDs.
+  uint32_t channels = channel_count(ws);
+#ifndef WS2812B_DISABLE_COLOR_CACHE
+  if (ws->state.color_cache != 0 && channels == 3) {
+    encode_colors_cached(ws, colors, count, dst);
+    return;
+  }
+#endif /* WS2812B_DISABLE_COLOR_CACHE */
+
+  encode_colors(ws, colors, count * channels, dst);
+}
+
+static void encode_range(ws2812b_handle_t *ws, uint32_t first, uint32_t count, uint8_t *dst) {
+  // Encodes LEDs first..first+count-1, at most one block.
+#ifndef WS2812B_DISABLE_PLANAR
+  if (planar_direct(ws)) {
+    encode_planar(ws, first, count, dst);
+    return;
+  }
+#endif /* WS2812B_DISABLE_PLANAR */
+
+  uint8_t colors[WS2812B_BLOCK_LEN * 4];
+  load_colors(ws, first, count, colors);
+  encode_block(ws, colors, count, dst);
+}
+
+#ifndef WS2812B_DISABLE_COLOR_CACHE
+
+static void encode_colors_cached(ws2812b_handle_t *ws, const uint8_t *colors, uint32_t count,
+                                 uint8_t *dst) {
+  // Every LED is compared with the previous one first, then looked up in the cache, and only
+  // encoded if both miss. Entries hold the output of the whole pipeline, so they stay valid
+  // for any source or color adjustment. The copy lengths are constant in each branch, so that
+  // the copies are inlined.
+  ws2812b_color_cache_t *cache = ws->state.color_cache;
+  bool single = ws->config.packing == WS2812B_PACKING_SINGLE;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t color = (uint32_t)colors[3 * i] << 16 | colors[3 * i + 1] << 8 | colors[3 * i + 2];
+
+    if (color == cache->last_color) {
+      cache->runs++;
+    } else {
+      uint32_t index = ((color * 2654435761U) >> 16) % WS2812B_COLOR_CACHE_LEN;
+      ws2812b_color_cache_entry_t *entry = &cache->entries[index];
+      if (entry->color == color) {
+        cache->hits++;
+      } else {
+        // Padded to 4 colors, which the SIMD encoder handles without a scalar remainder.
+        uint8_t padded[4] = {colors[3 * i], colors[3 * i + 1], colors[3 * i + 2], 0};
+        uint8_t encoded[32];
+        encode_colors(ws, padded, 4, encoded);
+        memcpy(entry->encoded, encoded, 24);
+        entry->color = color;
+        cache->misses++;
+      }
+      cache->last_color = color;
+      cache->last_entry = index;
+    }
+
+    const uint8_t *encoded = cache->entries[cache->last_entry].encoded;
+    if (single) {
+      memcpy(dst, encoded, 24);
+      dst += 24;
+    } else {
+      memcpy(dst, encoded, 12);
+      dst += 12;
+    }
+  }
+}
+
+#endif /* WS2812B_DISABLE_COLOR_CACHE */
+
+#ifdef WS2812B_STREAMING_STORES
+static void encode_leds_streaming(ws2812b_handle_t *ws, uint8_t *data_buffer) {
+  uint8_t *dst = data_buffer;
+
+  // LEDs are first encoded into a small staging buffer that stays in the cache, and then
+  // written out 16 bytes at a time using non-temporal stores, which bypass the cache and
+  // don't need to read the destination first. Bytes before the first 16-byte boundary
+  // and after the last one are written using regular stores.
+  uint8_t stage[WS2812B_BLOCK_LEN * 32 + 16];
+  uint32_t staged = 0;
+
+  for (uint32_t i = 0; i < ws->led_count; i += WS2812B_BLOCK_LEN) {
+    uint32_t count = ws->led_count - i < WS2812B_BLOCK_LEN ? ws->led_count - i : WS2812B_BLOCK_LEN;
+    encode_range(ws, i, count, &stage[staged]);
+    staged += data_len(ws, count);
+
+    uint32_t done = 0;
+
+    while (((uintptr_t)dst & 0xF) != 0 && done < staged) {
+      *dst = stage[done];
+      dst++;
+      done++;
+    }
+
+    while (staged - done >= 16) {
+      _mm_stream_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)&stage[done]));
+      dst += 16;
+      done += 16;
+    }
+
+    memmove(stage, &stage[done], staged - done);
+    staged -= done;
+  }
+
+  memcpy(dst, stage, staged);
+
+  // Make streaming stores visible before the buffer is handed on (e.g. to DMA).
+  _mm_sfence();
+}
+#endif /* WS2812B_STREAMING_STORES */
+
+static uint32_t add_zero_segments(uint32_t len, ws2812b_segment_t *segments) {
+  uint32_t count = 0;
+
+  while (len > 0) {
+    uint32_t segment_len = len < WS2812B_ZERO_BLOCK_LEN ? len : WS2812B_ZERO_BLOCK_LEN;
+    segments[count].ptr = zero_block;
+    segments[count].len = segment_len;
+    len -= segment_len;
+    count++;
+  }
+
+  return count;
+}
+
+static uint8_t iter_data_next(ws2812b_handle_t *ws, uint32_t i, uint32_t *iteration_index) {
+  // Determined which LED, color and bit(s) should be sent:
+  uint32_t led_bits = 8 * channel_count(ws);
+  uint32_t led = i / led_bits;
+
+  uint_fast8_t color = (i % led_bits) / 8;
+
+  uint_fast8_t bit = i % 8;
+
+  // Pre-encoded palette entries are sent as they are.
+#ifndef WS2812B_DISABLE_PALETTE
+  const uint8_t *encoded = palette_encoded(ws);
+  if (encoded != 0) {
+    uint32_t entry = palette_index(ws->state.source_data, led);
+    if (ws->config.packing == WS2812B_PACKING_SINGLE) {
+      *iteration_index += 1;
+      return encoded[24 * entry + i % 24];
+    }
+    *iteration_index += 2;
+    return encoded[12 * entry + (i % 24) / 2];
+  }
+#endif /* WS2812B_DISABLE_PALETTE */
+
+  // The LED's color is loaded once, when its first bit is sent. The iterator can not re-encode
+  // LEDs that were already sent, so the power limit always applies from the next frame on.
+  if (i % led_bits == 0) {
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+    if (led == 0) {
+      power_frame_start(ws, 0);
+    }
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+    load_colors(ws, led, 1, ws->state.iteration_color);
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+    if (led == ws->led_count - 1) {
+      power_frame_end(ws, 0);
+    }
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+  }
+
+  // Grab the current data byte in which the bit(s) that should
+  // be sent are located:
+  uint8_t data_byte = ws->state.iteration_color[color];
+
+  uint8_t result;
+  if (ws->config.packing == WS2812B_PACKING_SINGLE) {
+    // Single packing
+    result = construct_single_pulse(ws, bit, data_byte);
+    *iteration_index += 1;
+  } else {
+    // Double packing
+    result = construct_double_pulse(ws, bit, data_byte);
+    *iteration_index += 2;
+  }
+
+  return result;
+}
+
+static int check_chain(ws2812b_handle_t **handles, uint32_t count) {
+  // All handles are encoded into one stream, so they have to agree on how bits are encoded.
+  for (uint32_t i = 1; i < count; i++) {
+    const ws2812b_config_t *first = &handles[0]->config;
+    const ws2812b_config_t *config = &handles[i]->config;
+    WS2812B_INIT_ASSERT(config->packing == first->packing &&
+                            config->pulse_len_0 == first->pulse_len_0 &&
+                            config->pulse_len_1 == first->pulse_len_1 &&
+                            config->first_bit_0 == first->first_bit_0 &&
+                            config->spi_bit_order == first->spi_bit_order,
+                        "ws2812b: chained handles do not share packing and timing!");
+  }
+
+  return 0;
+}
+
+static void chain_iter_skip_finished(ws2812b_chain_t *chain) {
+  // Move on to the next handle once all data of the current one has been sent, and skip
+  // handles without LEDs. The iterator index is always handled as if in single packing mode.
+  if (chain->count == 0) {
+    return;
+  }
+
+  uint32_t prefix_len = chain->handles[0]->config.prefix_len;
+
+  while (chain->handle_index < chain->count) {
+    ws2812b_handle_t *ws = chain->handles[chain->handle_index];
+    uint32_t data_len = iter_data_len(ws);
+
+    if (chain->iteration_index < prefix_len + chain->data_offset + data_len) {
+      return;
+    }
+
+    chain->data_offset += data_len;
+    chain->handle_index++;
+  }
+}
+
 static uint8_t construct_single_pulse(ws2812b_handle_t *ws, uint_fast8_t b, uint8_t value) {
   return (value & ((0x80U) >> b) ? ws->state.pulse_1 : ws->state.pulse_0);
 }
@@ -19,6 +19,47 @@
 extern char *ws2812b_error_msg;
 #endif
 
+// Use non-temporal (streaming) stores to fill buffers with at least
+// WS2812B_STREAMING_THRESHOLD bytes of LED data. Avoids evicting other data
+// from the cache when filling very large buffers. Only has an effect on x86
+// targets with SSE2, ignored otherwise.
+// #define WS2812B_ENABLE_STREAMING_STORES
+
+// Disable the SIMD (SSE2) encoder on x86 targets, and always use the portable one.
+// #define WS2812B_DISABLE_SIMD
+
+// Leave out optional features to save code size. Everything is compiled in by
+// default. The functions of a disabled feature are not declared.
+// #define WS2812B_DISABLE_CURVES      // Color curves and curve generation.
+// #define WS2812B_DISABLE_LED16       // 16-bit LEDs with temporal dithering.
+// #define WS2812B_DISABLE_FLOAT       // Float and half-float input, and transfer curves.
+// #define WS2812B_DISABLE_HSV         // HSV input.
+// #define WS2812B_DISABLE_PIXELS      // Raw pixel input with pixel formats (RGBW).
+// #define WS2812B_DISABLE_PLANAR      // Planar LEDs.
+// #define WS2812B_DISABLE_RGB565      // RGB565 and RGB444 LEDs.
+// #define WS2812B_DISABLE_SHADER      // Shader input.
+// #define WS2812B_DISABLE_PALETTE     // Palette input.
+// #define WS2812B_DISABLE_CORRECTION  // Color correction matrix and per-LED calibration.
+// #define WS2812B_DISABLE_POWER_LIMIT // Power limit.
+// #define WS2812B_DISABLE_COLOR_CACHE // Encoded color cache.
+// #define WS2812B_DISABLE_LAYOUTS     // 2D layouts.
+
+#ifndef WS2812B_STREAMING_THRESHOLD
+#define WS2812B_STREAMING_THRESHOLD (4UL * 1024UL * 1024UL)
+#endif
+
+// Length of the shared block of zeros that prefix and suffix segments point to.
+// Longer prefixes/suffixes are split into multiple segments.
+#ifndef WS2812B_ZERO_BLOCK_LEN
+#define WS2812B_ZERO_BLOCK_LEN 64
+#endif
+
+// How many LEDs ahead framebuffer LEDs are prefetched when gathering through a layout table or
+// along columns, see ws2812b_set_layout. 0 disables prefetching.
+#ifndef WS2812B_LAYOUT_PREFETCH
+#define WS2812B_LAYOUT_PREFETCH 8
+#endif
+
 // Number of bits in a pulse
 typedef enum {
   WS2812B_PULSE_LEN_1b = 0x01,
@@ -52,10 +93,192 @@ typedef struct {
   uint32_t suffix_len;               // Number of zero bytes sent after every transmission.
 } ws2812b_config_t;
 
+// Color channels
+typedef enum {
+  WS2812B_CHANNEL_RED = 0,
+  WS2812B_CHANNEL_GREEN = 1,
+  WS2812B_CHANNEL_BLUE = 2,
+  WS2812B_CHANNEL_WHITE = 3, // Only with 4-channel pixel formats.
+} ws2812b_channel_t;
+
+// Where the encoder loads LED colors from.
+typedef enum {
+  WS2812B_SOURCE_LEDS = 0,  // ws2812b_led_t array (handle's leds member).
+  WS2812B_SOURCE_LED16 = 1, // ws2812b_led16_t array, see ws2812b_set_source_led16.
+  WS2812B_SOURCE_FLOAT = 2, // Float or half-float channels, see ws2812b_set_source_float.
+  WS2812B_SOURCE_HSV_SPECTRUM = 3, // ws2812b_hsv_t array, see ws2812b_set_source_hsv.
+  WS2812B_SOURCE_HSV_RAINBOW = 4,  // ws2812b_hsv_t array, see ws2812b_set_source_hsv.
+  WS2812B_SOURCE_PALETTE = 5,      // Palette indices, see ws2812b_set_source_palette.
+  WS2812B_SOURCE_PIXELS = 6,       // Raw pixel bytes, see ws2812b_set_source_pixels.
+  WS2812B_SOURCE_PLANAR = 7,       // One array per channel, see ws2812b_set_source_planar.
+  WS2812B_SOURCE_RGB565 = 8,       // 16-bit LEDs, see ws2812b_set_source_rgb565.
+  WS2812B_SOURCE_RGB444 = 9,       // 12-bit LEDs, see ws2812b_set_source_rgb444.
+  WS2812B_SOURCE_SHADER = 10,      // Colors computed on demand, see ws2812b_set_source_shader.
+} ws2812b_source_t;
+
+// Hue to color conversion
+typedef enum {
+  WS2812B_HSV_SPECTRUM = 0, // Red, green and blue each cover a third of the hue range.
+  WS2812B_HSV_RAINBOW = 1,  // Brighter yellow and orange, with the hue range split into 8 parts.
+} ws2812b_hsv_mode_t;
+
+// Layout of raw pixel input, and order in which the LEDs expect the channels.
+typedef struct {
+  uint32_t channels;  // 3, or 4 for RGBW LEDs (such as the SK6812 RGBW).
+  uint32_t stride;    // Bytes from one pixel to the next.
+  uint8_t offsets[4]; // Offset of each channel within a pixel, indexed by ws2812b_channel_t.
+  uint8_t order[4];   // Channels (ws2812b_channel_t) in the order they are sent.
+} ws2812b_pixel_format_t;
+
+// Common pixel formats, as initializers for ws2812b_pixel_format_t.
+#define WS2812B_PIXEL_FORMAT_RGB                                                                   \
+  {3, 3, {0, 1, 2, 0}, {WS2812B_CHANNEL_GREEN, WS2812B_CHANNEL_RED, WS2812B_CHANNEL_BLUE, 0}}
+#define WS2812B_PIXEL_FORMAT_BGR                                                                   \
+  {3, 3, {2, 1, 0, 0}, {WS2812B_CHANNEL_GREEN, WS2812B_CHANNEL_RED, WS2812B_CHANNEL_BLUE, 0}}
+#define WS2812B_PIXEL_FORMAT_RGBW                                                                  \
+  {4, 4, {0, 1, 2, 3},                                                                             \
+   {WS2812B_CHANNEL_GREEN, WS2812B_CHANNEL_RED, WS2812B_CHANNEL_BLUE, WS2812B_CHANNEL_WHITE}}
+
+// Planar LED storage: Separate red, green and blue arrays with one byte per LED. Every array has to
+// be aligned to WS2812B_PLANE_ALIGN bytes.
+#define WS2812B_PLANE_ALIGN 16
+typedef struct {
+  const uint8_t *red;
+  const uint8_t *green;
+  const uint8_t *blue;
+} ws2812b_planar_t;
+
+// RGB565 LED: Red in bits 15-11, green in bits 10-5 and blue in bits 4-0.
+#define WS2812B_RGB565(_red_, _green_, _blue_)                                                     \
+  ((uint16_t)(((_red_) >> 3) << 11 | ((_green_) >> 2) << 5 | (_blue_) >> 3))
+
+// RGB444 LEDs are packed into 12 bits each, as a sequence of R, G, B nibbles with the high nibble
+// of every byte first. See ws2812b_set_rgb444.
+#define WS2812B_RGB444_LEN(_led_count_) (((_led_count_) * 3 + 1) / 2)
+
+// Expansion of RGB565 or RGB444 channels to 8 bits, filled by the driver.
+typedef struct {
+  uint8_t red[64];
+  uint8_t green[64];
+  uint8_t blue[64];
+} ws2812b_expand_tables_t;
+
+// Number of entries of a transfer curve for float input.
+#define WS2812B_TRANSFER_CURVE_LEN 4096
+
+typedef enum {
+  WS2812B_FLOAT_F32 = 0, // float
+  WS2812B_FLOAT_F16 = 1, // IEEE 754 half-precision, stored as uint16_t
+} ws2812b_float_format_t;
+
+// Linear float input in [0, 1]. Values outside are clamped.
+typedef struct {
+  ws2812b_float_format_t format;
+  const void *red;         // First red value.
+  const void *green;       // First green value.
+  const void *blue;        // First blue value.
+  uint32_t stride;         // Values between two LEDs: 1 if planar, 3 if interleaved.
+  const uint8_t *transfer; // Transfer curve with WS2812B_TRANSFER_CURVE_LEN entries. 0: Linear.
+} ws2812b_float_source_t;
+
+// 3x3 color correction matrix, in Q12 fixed point (WS2812B_COLOR_MATRIX_ONE is 1.0).
+// Rows and columns are in R, G, B order: red_out = m[0][0] * red + m[0][1] * green + ...
+#define WS2812B_COLOR_MATRIX_ONE 4096
+typedef struct {
+  int16_t m[3][3];
+} ws2812b_color_matrix_t;
+
+// Per-LED calibration gain, applied as (value * (gain + 1)) / 256: 255 leaves a channel unchanged.
+typedef struct {
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+} ws2812b_gain_t;
+
+// How the power limit is enforced.
+typedef enum {
+  WS2812B_POWER_NEXT_FRAME = 0, // The frame is scaled down based on the previous frame's current.
+  WS2812B_POWER_REENCODE = 1,   // A frame over the budget is scaled down after encoding.
+} ws2812b_power_mode_t;
+
+// Power budget limiter, see ws2812b_set_power_limit.
+typedef struct {
+  ws2812b_power_mode_t mode;
+  uint32_t budget_ma;     // Maximum current of all LEDs.
+  uint32_t channel_ua[4]; // Current of a channel at full brightness, indexed by ws2812b_channel_t.
+  uint32_t idle_ua;       // Current of an LED that is off.
+
+  // Set by driver:
+  uint32_t scale;        // Scale applied to all channels, 256 if not limited.
+  uint64_t sums[4];      // Channel sums of frame being encoded, indexed by ws2812b_channel_t.
+  uint32_t requested_ma; // Estimated current of the last frame without limit.
+  uint32_t output_ma;    // Estimated current of the last frame as sent.
+  uint32_t frames;       // Number of frames encoded.
+  uint32_t limited;      // Number of frames that were scaled down.
+} ws2812b_power_t;
+
+// Layout of 2D matrices, see ws2812b_layout_t.
+#define WS2812B_LAYOUT_SERPENTINE (1 << 0)       // Every other row (column) of a panel is reversed.
+#define WS2812B_LAYOUT_COLUMNS (1 << 1)          // Panels are wired column by column.
+#define WS2812B_LAYOUT_TILES_SERPENTINE (1 << 2) // Every other row of panels is reversed.
+
+// Mapping of the LED chain onto a row-major framebuffer of tile_width * tiles_x by
+// tile_height * tiles_y LEDs, see ws2812b_set_layout. Panels are chained row by row, starting at
+// the top left, and every panel is wired starting at its top left LED.
+typedef struct {
+  const uint32_t *table; // Framebuffer index of every LED in chain order. 0: Use the rules below.
+  uint32_t tile_width;   // LEDs per row of a panel.
+  uint32_t tile_height;  // Rows of a panel.
+  uint32_t tiles_x;      // Panels per row of panels.
+  uint32_t tiles_y;      // Rows of panels.
+  uint32_t flags;        // WS2812B_LAYOUT_* flags.
+} ws2812b_layout_t;
+
+// Number of entries of an encoded color cache. Must be a power of two.
+#ifndef WS2812B_COLOR_CACHE_LEN
+#define WS2812B_COLOR_CACHE_LEN 64
+#endif
+
+typedef struct {
+  uint32_t color;      // Color in output order (G, R, B) in the low 24 bits, or ~0 if empty.
+  uint8_t encoded[24]; // Encoded color, of which 12 bytes are used in double packing.
+} ws2812b_color_cache_entry_t;
+
+// Direct-mapped cache of encoded colors, see ws2812b_set_color_cache.
+typedef struct {
+  ws2812b_color_cache_entry_t entries[WS2812B_COLOR_CACHE_LEN];
+  uint32_t last_color; // Color of the previous LED.
+  uint32_t last_entry; // Entry of the previous LED.
+
+  // Set by driver:
+  uint64_t runs;   // LEDs copied because they have the same color as the previous LED.
+  uint64_t hits;   // LEDs copied from the cache.
+  uint64_t misses; // LEDs encoded.
+} ws2812b_color_cache_t;
+
+// Cache maintenance hook: Clean (write back) the given range of memory.
+typedef void (*ws2812b_clean_range_t)(void *ptr, uint32_t len);
+
 typedef struct {
   uint8_t pulse_1;
   uint8_t pulse_0;
   uint32_t iteration_index;
+  uint8_t iteration_color[4]; // Color of LED currently being sent by iterator, in output order.
+  ws2812b_clean_range_t clean_range;
+  uint32_t cache_line_len;
+  const uint8_t *curves[3]; // Per-channel color curves, or 0 for channels without one.
+  const ws2812b_color_matrix_t *color_matrix; // 0 if disabled or identity.
+  const ws2812b_gain_t *calibration;          // Per-LED gains, or 0 if disabled.
+  ws2812b_power_t *power;                     // Power limiter, or 0 if disabled.
+  ws2812b_color_cache_t *color_cache;         // Encoded color cache, or 0 if disabled.
+  uint8_t *blackout;                          // Pre-built blackout frame, or 0 if not set.
+  const ws2812b_layout_t *layout;             // 2D layout of the LED array, or 0 if none.
+  uint32_t stale_first; // First LED changed in a buffer since the last ws2812b_sync_leds.
+  uint32_t stale_end;   // LED after the last changed one, or stale_first if none.
+  ws2812b_source_t source;
+  const ws2812b_pixel_format_t *pixel_format; // Format of WS2812B_SOURCE_PIXELS.
+  const void *source_data;
+  void *source_state;
 } ws2812b_state_t;
 
 typedef struct {
@@ -64,6 +287,41 @@ typedef struct {
   uint8_t blue;
 } ws2812b_led_t;
 
+typedef struct {
+  uint16_t red;
+  uint16_t green;
+  uint16_t blue;
+} ws2812b_led16_t;
+
+typedef struct {
+  uint8_t hue;
+  uint8_t saturation;
+  uint8_t value;
+} ws2812b_hsv_t;
+
+// Palette-indexed LEDs. Every palette entry is encoded once (see ws2812b_update_palette), and
+// frames are filled by copying the encoded entries.
+typedef struct {
+  uint32_t bits;               // Bits per index: 4 (two LEDs per byte, first in high nibble) or 8.
+  const uint8_t *indices;      // Palette index of every LED. Must be less than size.
+  const ws2812b_led_t *colors; // Palette entries.
+  uint32_t size;               // Number of entries: At most 16 (4-bit) or 256 (8-bit).
+  uint8_t *encoded;            // WS2812B_PALETTE_ENCODED_LEN bytes, filled by the driver.
+} ws2812b_palette_t;
+
+// Most LEDs requested from a batched shader at once.
+#define WS2812B_SHADER_BATCH_LEN 16
+
+// Procedural LED colors, computed while encoding instead of being stored. At least one of the two
+// functions has to be set. If both are, the batched one is used.
+typedef struct {
+  // Color of LED index.
+  ws2812b_led_t (*color_at)(uint32_t index, void *ctx);
+  // Colors of LEDs first..first+count-1, with count at most WS2812B_SHADER_BATCH_LEN.
+  void (*colors_at)(uint32_t first, uint32_t count, ws2812b_led_t *leds, void *ctx);
+  void *ctx;
+} ws2812b_shader_t;
+
 typedef struct {
   ws2812b_config_t config;
   uint32_t led_count;
@@ -71,20 +329,157 @@ typedef struct {
   ws2812b_state_t state;
 } ws2812b_handle_t;
 
+// Multiple handles sharing one data line, transmitted as a single frame.
+typedef struct {
+  ws2812b_handle_t **handles; // Handles, in the order the LEDs are connected.
+  uint32_t count;             // Number of handles.
+  uint32_t handle_index;      // Set by iterator.
+  uint32_t data_offset;       // Set by iterator.
+  uint32_t iteration_index;   // Set by iterator.
+} ws2812b_chain_t;
+
+// Part of a transmission, as used for scatter-gather/linked-list DMA.
+typedef struct {
+  const uint8_t *ptr;
+  uint32_t len;
+} ws2812b_segment_t;
+
 #define WS2812B_REQUIRED_BUFFER_LEN(_led_count_, _packing_, _prefix_, _suffix_)                    \
   (WS2812B_DATA_LEN(_led_count_, _packing_) + (_prefix_) + (_suffix_))
 
-#define WS2812B_DATA_LEN(_led_count_, _packing_)                                                   \
-  ((_led_count_) * ((_packing_) == WS2812B_PACKING_SINGLE ? 24 : 12))
+#define WS2812B_DATA_LEN(_led_count_, _packing_) WS2812B_PIXEL_DATA_LEN(_led_count_, 3, _packing_)
+
+// Lengths for LEDs with any number of channels, see ws2812b_pixel_format_t.
+#define WS2812B_PIXEL_BUFFER_LEN(_led_count_, _channels_, _packing_, _prefix_, _suffix_)           \
+  (WS2812B_PIXEL_DATA_LEN(_led_count_, _channels_, _packing_) + (_prefix_) + (_suffix_))
+
+#define WS2812B_PIXEL_DATA_LEN(_led_count_, _channels_, _packing_)                                 \
+  ((_led_count_) * (_channels_) * ((_packing_) == WS2812B_PACKING_SINGLE ? 8 : 4))
+
+// The LEDs of an in-place buffer are stored within its own encoded data, so no additional
+// memory is required.
+#define WS2812B_INPLACE_BUFFER_LEN(_led_count_, _packing_, _prefix_, _suffix_)                     \
+  WS2812B_REQUIRED_BUFFER_LEN(_led_count_, _packing_, _prefix_, _suffix_)
+
+// Length of the encoded entries of a palette, see ws2812b_palette_t.
+#define WS2812B_PALETTE_ENCODED_LEN(_size_, _packing_) WS2812B_DATA_LEN(_size_, _packing_)
+
+#define WS2812B_ZERO_SEGMENT_COUNT(_len_)                                                          \
+  (((_len_) + WS2812B_ZERO_BLOCK_LEN - 1) / WS2812B_ZERO_BLOCK_LEN)
+
+#define WS2812B_REQUIRED_SEGMENT_COUNT(_prefix_, _suffix_)                                         \
+  (WS2812B_ZERO_SEGMENT_COUNT(_prefix_) + 1 + WS2812B_ZERO_SEGMENT_COUNT(_suffix_))
 
 int ws2812b_init(ws2812b_handle_t *ws);
 
+int ws2812b_retarget(ws2812b_handle_t *ws, const ws2812b_config_t *config, uint8_t *buffer);
+
+int ws2812b_set_clean_hook(ws2812b_handle_t *ws, ws2812b_clean_range_t clean_range,
+                           uint32_t cache_line_len);
+
+#ifndef WS2812B_DISABLE_CURVES
+int ws2812b_set_color_curve(ws2812b_handle_t *ws, ws2812b_channel_t ch, const uint8_t *curve);
+void ws2812b_generate_color_curve(uint8_t *curve, float gamma, uint8_t brightness);
+#endif /* WS2812B_DISABLE_CURVES */
+
+#ifndef WS2812B_DISABLE_LED16
+void ws2812b_set_source_led16(ws2812b_handle_t *ws, const ws2812b_led16_t *leds,
+                              ws2812b_led_t *dither_errors);
+#endif /* WS2812B_DISABLE_LED16 */
+
+#ifndef WS2812B_DISABLE_FLOAT
+void ws2812b_set_source_float(ws2812b_handle_t *ws, const ws2812b_float_source_t *source);
+void ws2812b_generate_transfer_curve(uint8_t *curve, float gamma, uint8_t brightness);
+#endif /* WS2812B_DISABLE_FLOAT */
+
+#ifndef WS2812B_DISABLE_HSV
+void ws2812b_set_source_hsv(ws2812b_handle_t *ws, const ws2812b_hsv_t *leds,
+                            ws2812b_hsv_mode_t mode);
+#endif /* WS2812B_DISABLE_HSV */
+
+#ifndef WS2812B_DISABLE_PIXELS
+int ws2812b_set_source_pixels(ws2812b_handle_t *ws, const uint8_t *pixels,
+                              const ws2812b_pixel_format_t *format);
+#endif /* WS2812B_DISABLE_PIXELS */
+
+#ifndef WS2812B_DISABLE_PLANAR
+int ws2812b_set_source_planar(ws2812b_handle_t *ws, const ws2812b_planar_t *planes);
+#endif /* WS2812B_DISABLE_PLANAR */
+
+#ifndef WS2812B_DISABLE_RGB565
+void ws2812b_set_source_rgb565(ws2812b_handle_t *ws, const uint16_t *leds,
+                               ws2812b_expand_tables_t *tables);
+void ws2812b_set_source_rgb444(ws2812b_handle_t *ws, const uint8_t *leds,
+                               ws2812b_expand_tables_t *tables);
+void ws2812b_set_rgb444(uint8_t *leds, uint32_t index, ws2812b_led_t color);
+void ws2812b_update_expand_tables(ws2812b_handle_t *ws);
+#endif /* WS2812B_DISABLE_RGB565 */
+
+#ifndef WS2812B_DISABLE_SHADER
+int ws2812b_set_source_shader(ws2812b_handle_t *ws, const ws2812b_shader_t *shader);
+#endif /* WS2812B_DISABLE_SHADER */
+
+#ifndef WS2812B_DISABLE_PALETTE
+int ws2812b_set_source_palette(ws2812b_handle_t *ws, ws2812b_palette_t *palette);
+void ws2812b_update_palette(ws2812b_handle_t *ws);
+#endif /* WS2812B_DISABLE_PALETTE */
+
+#ifndef WS2812B_DISABLE_CORRECTION
+void ws2812b_set_color_matrix(ws2812b_handle_t *ws, const ws2812b_color_matrix_t *matrix);
+void ws2812b_color_matrix_identity(ws2812b_color_matrix_t *matrix);
+void ws2812b_color_matrix_white_point(ws2812b_color_matrix_t *matrix, uint8_t red, uint8_t green,
+                                      uint8_t blue);
+
+void ws2812b_set_calibration(ws2812b_handle_t *ws, const ws2812b_gain_t *gains);
+#endif /* WS2812B_DISABLE_CORRECTION */
+
+#ifndef WS2812B_DISABLE_POWER_LIMIT
+void ws2812b_set_power_limit(ws2812b_handle_t *ws, ws2812b_power_t *power);
+#endif /* WS2812B_DISABLE_POWER_LIMIT */
+
+#ifndef WS2812B_DISABLE_COLOR_CACHE
+void ws2812b_set_color_cache(ws2812b_handle_t *ws, ws2812b_color_cache_t *cache);
+#endif /* WS2812B_DISABLE_COLOR_CACHE */
+
+#ifndef WS2812B_DISABLE_LAYOUTS
+int ws2812b_set_layout(ws2812b_handle_t *ws, const ws2812b_layout_t *layout);
+#endif /* WS2812B_DISABLE_LAYOUTS */
+
 uint32_t ws2812b_required_buffer_len(ws2812b_handle_t *ws);
 
 void ws2812b_fill_buffer(ws2812b_handle_t *ws, uint8_t *buffer);
 
+void ws2812b_fill_solid(ws2812b_handle_t *ws, uint8_t *buffer, ws2812b_led_t color,
+                        uint32_t first, uint32_t count);
+void ws2812b_set_blackout_frame(ws2812b_handle_t *ws, uint8_t *frame);
+void ws2812b_fill_blackout(ws2812b_handle_t *ws, uint8_t *buffer);
+
+// Operations on LEDs of an already filled buffer. Positive shifts move LEDs towards higher
+// indices.
+void ws2812b_rotate_leds(ws2812b_handle_t *ws, uint8_t *buffer, uint32_t first, uint32_t count,
+                         int32_t shift);
+void ws2812b_scroll_leds(ws2812b_handle_t *ws, uint8_t *buffer, uint32_t first, uint32_t count,
+                         int32_t shift, ws2812b_led_t fill);
+void ws2812b_mirror_leds(ws2812b_handle_t *ws, uint8_t *buffer, uint32_t first, uint32_t count);
+void ws2812b_copy_leds(ws2812b_handle_t *ws, uint8_t *buffer, uint32_t dst_first,
+                       uint32_t src_first, uint32_t count);
+void ws2812b_sync_leds(ws2812b_handle_t *ws, const uint8_t *buffer);
+
+ws2812b_led_t *ws2812b_inplace_leds(ws2812b_handle_t *ws, uint8_t *buffer);
+
+void ws2812b_fill_data(ws2812b_handle_t *ws, uint8_t *data_buffer);
+uint32_t ws2812b_fill_segments(ws2812b_handle_t *ws, uint8_t *data_buffer,
+                               ws2812b_segment_t *segments);
+
 void ws2812b_iter_restart(ws2812b_handle_t *ws);
 bool ws2812b_iter_is_finished(ws2812b_handle_t *ws);
 uint8_t ws2812b_iter_next(ws2812b_handle_t *ws);
 
+uint32_t ws2812b_chain_required_buffer_len(ws2812b_handle_t **handles, uint32_t count);
+int ws2812b_fill_chain(ws2812b_handle_t **handles, uint32_t count, uint8_t *buffer);
+
+int ws2812b_chain_iter_restart(ws2812b_chain_t *chain);
+bool ws2812b_chain_iter_is_finished(ws2812b_chain_t *chain);
+uint8_t ws2812b_chain_iter_next(ws2812b_chain_t *chain);
+
 #endif /* INC_WS2812bB_H_ */
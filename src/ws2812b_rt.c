@@ -0,0 +1,227 @@
+/*
+ * ws2812b_rt.c
+ *
+ *  Linux real-time transmit thread for frames generated by the ws2812b driver.
+ *
+ *  Frame jitter on Linux is mostly caused by page faults and preemption around the
+ *  transmission, so the thread runs with SCHED_FIFO on a fixed CPU, with its memory locked
+ *  and prefaulted, and paces frames against absolute deadlines. Every real-time feature is
+ *  optional: If it can not be enabled (usually for lack of privileges), the thread runs
+ *  without it and the failure is recorded in ws2812b_rt_t.degraded.
+ */
+
+#define _GNU_SOURCE
+#include "ws2812b_rt.h"
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// ======== Private Prototypes =====================================================================
+
+static void *thread_main(void *arg);
+static void degrade(ws2812b_rt_t *rt, uint32_t flag, int err);
+static void prefault_buffers(ws2812b_rt_t *rt);
+static void prefault_stack(void);
+static void record_lateness(ws2812b_rt_t *rt, uint64_t lateness_ns);
+static uint64_t timespec_ns(const struct timespec *ts);
+static struct timespec ns_timespec(uint64_t ns);
+
+// ======== Public Functions =======================================================================
+
+int ws2812b_rt_start(ws2812b_rt_t *rt) {
+  rt->running = false;
+  rt->stop = false;
+  rt->degraded = 0;
+  rt->degraded_errno = 0;
+  rt->frames = 0;
+  rt->deadline_misses = 0;
+  rt->max_lateness_ns = 0;
+  memset(rt->histogram, 0, sizeof(rt->histogram));
+
+  if (rt->config.frame == 0 || rt->config.period_ns == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Lock before prefaulting, so that the prefaulted pages stay resident.
+  if (rt->config.lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    degrade(rt, WS2812B_RT_DEGRADED_MLOCK, errno);
+  }
+  prefault_buffers(rt);
+
+  if (sem_init(&rt->ready, 0, 0) != 0) {
+    return -1;
+  }
+
+  int err = pthread_create(&rt->thread, NULL, thread_main, rt);
+  if (err != 0) {
+    sem_destroy(&rt->ready);
+    errno = err;
+    return -1;
+  }
+  rt->running = true;
+
+  // The thread waits for its affinity and scheduling policy to be set before the first frame.
+  if (rt->config.pin_cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(rt->config.cpu, &set);
+    err = pthread_setaffinity_np(rt->thread, sizeof(set), &set);
+    if (err != 0) {
+      degrade(rt, WS2812B_RT_DEGRADED_AFFINITY, err);
+    }
+  }
+
+  if (rt->config.priority > 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = rt->config.priority;
+    err = pthread_setschedparam(rt->thread, SCHED_FIFO, &param);
+    if (err != 0) {
+      degrade(rt, WS2812B_RT_DEGRADED_SCHED, err);
+    }
+  }
+
+  sem_post(&rt->ready);
+  return 0;
+}
+
+void ws2812b_rt_stop(ws2812b_rt_t *rt) {
+  if (!rt->running) {
+    return;
+  }
+
+  __atomic_store_n(&rt->stop, true, __ATOMIC_RELAXED);
+  pthread_join(rt->thread, NULL);
+  sem_destroy(&rt->ready);
+  rt->running = false;
+}
+
+uint64_t ws2812b_rt_lateness_percentile(const ws2812b_rt_t *rt, double percentile) {
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < WS2812B_RT_HISTOGRAM_BUCKETS; i++) {
+    total += rt->histogram[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  // Smallest bucket that covers the requested share of frames. Its upper bound is
+  // reported, limited to the largest lateness actually observed.
+  double target = total * percentile / 100.0;
+  uint64_t count = 0;
+  for (uint32_t i = 0; i < WS2812B_RT_HISTOGRAM_BUCKETS; i++) {
+    count += rt->histogram[i];
+    if (count >= target) {
+      uint64_t bound = i == 0 ? 0 : ((uint64_t)1 << i) - 1;
+      return bound < rt->max_lateness_ns ? bound : rt->max_lateness_ns;
+    }
+  }
+  return rt->max_lateness_ns;
+}
+
+// ======== Private Functions ======================================================================
+
+static void *thread_main(void *arg) {
+  ws2812b_rt_t *rt = arg;
+
+  while (sem_wait(&rt->ready) != 0 && errno == EINTR) {
+  }
+  prefault_stack();
+
+  uint64_t period = rt->config.period_ns;
+  uint64_t miss = rt->config.miss_ns != 0 ? rt->config.miss_ns : period;
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  uint64_t deadline = timespec_ns(&ts) + period;
+
+  while (!__atomic_load_n(&rt->stop, __ATOMIC_RELAXED)) {
+    // Absolute deadlines, so that time spent transmitting does not accumulate as drift.
+    struct timespec wake = ns_timespec(deadline);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR) {
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = timespec_ns(&ts);
+    uint64_t lateness = now > deadline ? now - deadline : 0;
+    record_lateness(rt, lateness);
+    if (lateness >= miss) {
+      rt->deadline_misses++;
+    }
+
+    int ret = rt->config.frame(rt->config.ctx, rt->frames);
+    rt->frames++;
+    if (ret != 0) {
+      break;
+    }
+
+    // Deadlines that passed entirely while transmitting are skipped, not caught up on.
+    deadline += period;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = timespec_ns(&ts);
+    while (now >= deadline + period) {
+      deadline += period;
+      rt->deadline_misses++;
+    }
+  }
+
+  return NULL;
+}
+
+static void degrade(ws2812b_rt_t *rt, uint32_t flag, int err) {
+  rt->degraded |= flag;
+  rt->degraded_errno = err;
+}
+
+static void prefault_buffers(ws2812b_rt_t *rt) {
+  // Write to every page, so that copy-on-write and zero pages are replaced by real ones
+  // before the first frame.
+  long page_len = sysconf(_SC_PAGESIZE);
+  if (page_len <= 0) {
+    page_len = 4096;
+  }
+
+  for (uint32_t b = 0; b < rt->config.buffer_count; b++) {
+    volatile uint8_t *buffer = rt->config.buffers[b];
+    for (uint32_t i = 0; i < rt->config.buffer_len; i += page_len) {
+      buffer[i] = buffer[i];
+    }
+    if (rt->config.buffer_len > 0) {
+      buffer[rt->config.buffer_len - 1] = buffer[rt->config.buffer_len - 1];
+    }
+  }
+}
+
+static void prefault_stack(void) {
+  volatile uint8_t stack[WS2812B_RT_PREFAULT_STACK_LEN];
+  for (uint32_t i = 0; i < sizeof(stack); i += 256) {
+    stack[i] = 0;
+  }
+}
+
+static void record_lateness(ws2812b_rt_t *rt, uint64_t lateness_ns) {
+  uint32_t bucket = 0;
+  while (bucket < WS2812B_RT_HISTOGRAM_BUCKETS - 1 && (lateness_ns >> bucket) != 0) {
+    bucket++;
+  }
+  rt->histogram[bucket]++;
+
+  if (lateness_ns > rt->max_lateness_ns) {
+    rt->max_lateness_ns = lateness_ns;
+  }
+}
+
+static uint64_t timespec_ns(const struct timespec *ts) {
+  return (uint64_t)ts->tv_sec * 1000000000u + ts->tv_nsec;
+}
+
+static struct timespec ns_timespec(uint64_t ns) {
+  struct timespec ts;
+  ts.tv_sec = ns / 1000000000u;
+  ts.tv_nsec = ns % 1000000000u;
+  return ts;
+}
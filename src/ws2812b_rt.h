@@ -0,0 +1,69 @@
+/*
+ * ws2812b_rt.h
+ *
+ *  Linux real-time transmit thread for frames generated by the ws2812b driver.
+ */
+
+#ifndef INC_WS2812B_RT_H_
+#define INC_WS2812B_RT_H_
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Number of lateness histogram buckets. Bucket i counts lateness in [2^(i-1), 2^i) ns,
+// bucket 0 counts frames that started on time.
+#define WS2812B_RT_HISTOGRAM_BUCKETS 40
+
+// Stack prefaulted by the transmit thread before entering its loop.
+#ifndef WS2812B_RT_PREFAULT_STACK_LEN
+#define WS2812B_RT_PREFAULT_STACK_LEN (64 * 1024)
+#endif
+
+// Flags set in ws2812b_rt_t.degraded for every real-time feature that could not be enabled.
+#define WS2812B_RT_DEGRADED_AFFINITY (1 << 0)
+#define WS2812B_RT_DEGRADED_SCHED (1 << 1)
+#define WS2812B_RT_DEGRADED_MLOCK (1 << 2)
+
+// Called once per period to transmit a frame. A non-zero return stops the thread.
+typedef int (*ws2812b_rt_frame_t)(void *ctx, uint64_t frame_index);
+
+typedef struct {
+  ws2812b_rt_frame_t frame; // Transmits a frame.
+  void *ctx;                // Passed to frame.
+  uint64_t period_ns;       // Frame period.
+  uint64_t miss_ns;         // Lateness at which a frame counts as missed. 0: period_ns.
+  bool pin_cpu;             // Pin the thread to cpu. Default (false): No pinning.
+  int cpu;                  // CPU to pin the thread to, if pin_cpu is set.
+  int priority;             // SCHED_FIFO priority. 0: Normal scheduling.
+  bool lock_memory;         // Lock all current and future memory with mlockall.
+  uint8_t **buffers;        // Optional frame buffers to prefault.
+  uint32_t buffer_count;    // Number of frame buffers.
+  uint32_t buffer_len;      // Length of each buffer (usually ws2812b_required_buffer_len).
+} ws2812b_rt_config_t;
+
+typedef struct {
+  ws2812b_rt_config_t config;
+  pthread_t thread;
+  sem_t ready;
+  bool running;
+  bool stop;
+
+  // Real-time features that could not be enabled, with the errno of the last failure.
+  uint32_t degraded;
+  int degraded_errno;
+
+  // Statistics. Only consistent while the thread is stopped.
+  uint64_t frames;
+  uint64_t deadline_misses;
+  uint64_t max_lateness_ns;
+  uint64_t histogram[WS2812B_RT_HISTOGRAM_BUCKETS];
+} ws2812b_rt_t;
+
+int ws2812b_rt_start(ws2812b_rt_t *rt);
+void ws2812b_rt_stop(ws2812b_rt_t *rt);
+
+uint64_t ws2812b_rt_lateness_percentile(const ws2812b_rt_t *rt, double percentile);
+
+#endif /* INC_WS2812B_RT_H_ */
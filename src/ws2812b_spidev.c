@@ -0,0 +1,144 @@
+/*
+ * ws2812b_spidev.c
+ *
+ *  Linux spidev transport for buffers generated by the ws2812b driver.
+ */
+
+#include "ws2812b_spidev.h"
+#include <fcntl.h>
+#include <linux/spi/spidev.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+// ======== Private Prototypes =====================================================================
+
+static int system_ioctl(int fd, unsigned long request, void *arg);
+static uint32_t read_bufsiz(const char *path);
+static int send_message(ws2812b_spidev_t *dev, struct spi_ioc_transfer *xfers, uint32_t count);
+
+// ======== Public Functions =======================================================================
+
+int ws2812b_spidev_open(ws2812b_spidev_t *dev, ws2812b_handle_t *ws) {
+  if (dev->config.ioctl == 0) {
+    dev->config.ioctl = system_ioctl;
+  }
+
+  dev->bufsiz = read_bufsiz(dev->config.bufsiz_path != 0 ? dev->config.bufsiz_path
+                                                         : WS2812B_SPIDEV_BUFSIZ_PATH);
+
+  dev->speed_hz = dev->config.speed_hz;
+  if (dev->speed_hz == 0) {
+    dev->speed_hz = ws->config.packing == WS2812B_PACKING_SINGLE ? WS2812B_SPIDEV_SPEED_SINGLE
+                                                                 : WS2812B_SPIDEV_SPEED_DOUBLE;
+  }
+
+  dev->fd = open(dev->config.path, O_RDWR);
+  if (dev->fd < 0) {
+    return -1;
+  }
+
+  // Configure SPI port to match the driver's output format
+  uint8_t mode = dev->config.mode;
+  uint8_t lsb_first = ws->config.spi_bit_order == WS2812B_LSB_FIRST;
+  uint8_t bits_per_word = 8;
+  uint32_t speed_hz = dev->speed_hz;
+
+  if (dev->config.ioctl(dev->fd, SPI_IOC_WR_MODE, &mode) < 0 ||
+      dev->config.ioctl(dev->fd, SPI_IOC_WR_LSB_FIRST, &lsb_first) < 0 ||
+      dev->config.ioctl(dev->fd, SPI_IOC_WR_BITS_PER_WORD, &bits_per_word) < 0 ||
+      dev->config.ioctl(dev->fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed_hz) < 0) {
+    ws2812b_spidev_close(dev);
+    return -1;
+  }
+
+  return 0;
+}
+
+void ws2812b_spidev_close(ws2812b_spidev_t *dev) {
+  if (dev->fd >= 0) {
+    close(dev->fd);
+  }
+  dev->fd = -1;
+}
+
+int ws2812b_spidev_transmit(ws2812b_spidev_t *dev, const uint8_t *buffer, uint32_t len) {
+  ws2812b_segment_t segment = {.ptr = buffer, .len = len};
+  return ws2812b_spidev_transmit_segments(dev, &segment, 1);
+}
+
+int ws2812b_spidev_transmit_segments(ws2812b_spidev_t *dev, const ws2812b_segment_t *segments,
+                                     uint32_t count) {
+  // spidev limits the total length of a message to its buffer size. Segments are packed into as
+  // few messages as possible, splitting them where a message is full. Transfers within a message
+  // are sent back-to-back without de-asserting CS or adding delays. There will usually be a short
+  // gap between messages, so the spidev buffer size should be large enough to hold a whole frame
+  // where possible (spidev.bufsiz kernel parameter).
+  struct spi_ioc_transfer xfers[WS2812B_SPIDEV_MAX_TRANSFERS];
+  uint32_t xfer_count = 0;
+  uint32_t message_len = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    const uint8_t *ptr = segments[i].ptr;
+    uint32_t remaining = segments[i].len;
+
+    while (remaining > 0) {
+      if (xfer_count == WS2812B_SPIDEV_MAX_TRANSFERS || message_len == dev->bufsiz) {
+        if (send_message(dev, xfers, xfer_count)) {
+          return -1;
+        }
+        xfer_count = 0;
+        message_len = 0;
+      }
+
+      uint32_t len = dev->bufsiz - message_len;
+      if (remaining < len) {
+        len = remaining;
+      }
+
+      memset(&xfers[xfer_count], 0, sizeof(struct spi_ioc_transfer));
+      xfers[xfer_count].tx_buf = (uintptr_t)ptr;
+      xfers[xfer_count].len = len;
+      xfers[xfer_count].speed_hz = dev->speed_hz;
+      xfers[xfer_count].bits_per_word = 8;
+      xfers[xfer_count].cs_change = 0;
+      xfers[xfer_count].delay_usecs = 0;
+
+      xfer_count++;
+      message_len += len;
+      ptr += len;
+      remaining -= len;
+    }
+  }
+
+  if (xfer_count > 0) {
+    return send_message(dev, xfers, xfer_count);
+  }
+
+  return 0;
+}
+
+// ======== Private Functions ======================================================================
+
+static int system_ioctl(int fd, unsigned long request, void *arg) {
+  return ioctl(fd, request, arg);
+}
+
+static uint32_t read_bufsiz(const char *path) {
+  unsigned long bufsiz = 0;
+
+  FILE *f = fopen(path, "r");
+  if (f != 0) {
+    if (fscanf(f, "%lu", &bufsiz) != 1) {
+      bufsiz = 0;
+    }
+    fclose(f);
+  }
+
+  return bufsiz != 0 ? (uint32_t)bufsiz : WS2812B_SPIDEV_DEFAULT_BUFSIZ;
+}
+
+static int send_message(ws2812b_spidev_t *dev, struct spi_ioc_transfer *xfers, uint32_t count) {
+  return dev->config.ioctl(dev->fd, SPI_IOC_MESSAGE(count), xfers) < 0 ? -1 : 0;
+}
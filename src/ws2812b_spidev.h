@@ -0,0 +1,50 @@
+/*
+ * ws2812b_spidev.h
+ *
+ *  Linux spidev transport for buffers generated by the ws2812b driver.
+ */
+
+#ifndef INC_WS2812B_SPIDEV_H_
+#define INC_WS2812B_SPIDEV_H_
+
+#include "ws2812b.h"
+#include <stdint.h>
+
+// Maximum number of transfers submitted with a single SPI_IOC_MESSAGE ioctl.
+#ifndef WS2812B_SPIDEV_MAX_TRANSFERS
+#define WS2812B_SPIDEV_MAX_TRANSFERS 16
+#endif
+
+// Where the spidev buffer size is read from, and the size assumed if that fails.
+#define WS2812B_SPIDEV_BUFSIZ_PATH "/sys/module/spidev/parameters/bufsiz"
+#define WS2812B_SPIDEV_DEFAULT_BUFSIZ 4096
+
+// SPI clock frequencies used if none is configured.
+#define WS2812B_SPIDEV_SPEED_SINGLE 6400000
+#define WS2812B_SPIDEV_SPEED_DOUBLE 3200000
+
+typedef int (*ws2812b_spidev_ioctl_t)(int fd, unsigned long request, void *arg);
+
+typedef struct {
+  const char *path;             // Device path, e.g. "/dev/spidev0.0".
+  const char *bufsiz_path;      // File with spidev buffer size. 0: WS2812B_SPIDEV_BUFSIZ_PATH.
+  uint32_t speed_hz;            // SPI clock frequency. 0: Default for packing.
+  uint8_t mode;                 // SPI mode (SPI_MODE_0 .. SPI_MODE_3).
+  ws2812b_spidev_ioctl_t ioctl; // ioctl implementation. 0: System ioctl.
+} ws2812b_spidev_config_t;
+
+typedef struct {
+  ws2812b_spidev_config_t config;
+  int fd;
+  uint32_t bufsiz;
+  uint32_t speed_hz;
+} ws2812b_spidev_t;
+
+int ws2812b_spidev_open(ws2812b_spidev_t *dev, ws2812b_handle_t *ws);
+void ws2812b_spidev_close(ws2812b_spidev_t *dev);
+
+int ws2812b_spidev_transmit(ws2812b_spidev_t *dev, const uint8_t *buffer, uint32_t len);
+int ws2812b_spidev_transmit_segments(ws2812b_spidev_t *dev, const ws2812b_segment_t *segments,
+                                     uint32_t count);
+
+#endif /* INC_WS2812B_SPIDEV_H_ */
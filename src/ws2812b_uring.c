@@ -0,0 +1,334 @@
+/*
+ * ws2812b_uring.c
+ *
+ *  Linux io_uring based asynchronous frame writer for buffers generated by the ws2812b driver.
+ *
+ *  Uses the raw io_uring system calls, so no liburing is needed.
+ */
+
+#include "ws2812b_uring.h"
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// ======== Private Types ==========================================================================
+
+typedef enum {
+  BUFFER_FREE = 0,
+  BUFFER_ACQUIRED,
+  BUFFER_IN_FLIGHT, // Queued or submitted.
+} buffer_state_t;
+
+// ======== Private Prototypes =====================================================================
+
+static int map_rings(ws2812b_uring_t *ur, struct io_uring_params *p);
+static void register_buffers(ws2812b_uring_t *ur);
+
+// ======== Public Functions =======================================================================
+
+int ws2812b_uring_init(ws2812b_uring_t *ur) {
+  ur->ring_fd = -1;
+  ur->sq_map = MAP_FAILED;
+  ur->cq_map = MAP_FAILED;
+  ur->sqes = MAP_FAILED;
+  ur->free_buffers = 0;
+  ur->buffer_states = 0;
+  ur->queued_lens = 0;
+  ur->queued_fds = 0;
+  ur->queued = 0;
+  ur->in_flight = 0;
+  ur->completed = 0;
+  ur->errors = 0;
+  ur->last_error = 0;
+
+  if (ur->config.buffer_count == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Every buffer can be queued or in flight at most once, so a ring with as many entries
+  // as there are buffers never overflows.
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  ur->ring_fd = syscall(__NR_io_uring_setup, ur->config.buffer_count, &p);
+  if (ur->ring_fd < 0) {
+    return -1;
+  }
+
+  if (map_rings(ur, &p)) {
+    ws2812b_uring_close(ur);
+    return -1;
+  }
+
+  ur->free_buffers = malloc(sizeof(uint32_t) * ur->config.buffer_count);
+  ur->buffer_states = calloc(ur->config.buffer_count, sizeof(uint8_t));
+  ur->queued_lens = calloc(ur->config.buffer_count, sizeof(uint32_t));
+  ur->queued_fds = calloc(ur->config.buffer_count, sizeof(int));
+  if (ur->free_buffers == 0 || ur->buffer_states == 0 || ur->queued_lens == 0 ||
+      ur->queued_fds == 0) {
+    ws2812b_uring_close(ur);
+    return -1;
+  }
+
+  // Buffers are handed out in order, starting at index 0.
+  for (uint32_t i = 0; i < ur->config.buffer_count; i++) {
+    ur->free_buffers[i] = ur->config.buffer_count - 1 - i;
+  }
+  ur->free_count = ur->config.buffer_count;
+
+  register_buffers(ur);
+
+  return 0;
+}
+
+void ws2812b_uring_close(ws2812b_uring_t *ur) {
+  if (ur->sqes != MAP_FAILED) {
+    munmap(ur->sqes, ur->sqes_map_len);
+  }
+  if (ur->cq_map != MAP_FAILED && ur->cq_map != ur->sq_map) {
+    munmap(ur->cq_map, ur->cq_map_len);
+  }
+  if (ur->sq_map != MAP_FAILED) {
+    munmap(ur->sq_map, ur->sq_map_len);
+  }
+  if (ur->ring_fd >= 0) {
+    close(ur->ring_fd);
+  }
+  free(ur->free_buffers);
+  free(ur->buffer_states);
+  free(ur->queued_lens);
+  free(ur->queued_fds);
+
+  ur->ring_fd = -1;
+  ur->sq_map = MAP_FAILED;
+  ur->cq_map = MAP_FAILED;
+  ur->sqes = MAP_FAILED;
+  ur->free_buffers = 0;
+  ur->buffer_states = 0;
+  ur->queued_lens = 0;
+  ur->queued_fds = 0;
+}
+
+int ws2812b_uring_acquire(ws2812b_uring_t *ur) {
+  if (ur->free_count == 0) {
+    return -1;
+  }
+
+  ur->free_count--;
+  uint32_t buffer_index = ur->free_buffers[ur->free_count];
+  ur->buffer_states[buffer_index] = BUFFER_ACQUIRED;
+  return buffer_index;
+}
+
+int ws2812b_uring_queue(ws2812b_uring_t *ur, int fd, uint32_t buffer_index, uint32_t len) {
+  if (buffer_index >= ur->config.buffer_count || len > ur->config.buffer_len) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Only acquired buffers can be queued, and only once until they complete. Otherwise, a buffer
+  // would be recycled more than once.
+  if (ur->buffer_states[buffer_index] != BUFFER_ACQUIRED) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Writes to the same file descriptor may complete in any order, so only one per descriptor
+  // can be queued or in flight at a time.
+  for (uint32_t i = 0; i < ur->config.buffer_count; i++) {
+    if (ur->buffer_states[i] == BUFFER_IN_FLIGHT && ur->queued_fds[i] == fd) {
+      errno = EBUSY;
+      return -1;
+    }
+  }
+
+  // Only this thread produces submissions, only the kernel consumes them.
+  uint32_t tail = *ur->sq_tail;
+  uint32_t head = __atomic_load_n(ur->sq_head, __ATOMIC_ACQUIRE);
+  if (tail - head >= ur->sq_entries) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  uint32_t index = tail & *ur->sq_mask;
+  struct io_uring_sqe *sqe = &((struct io_uring_sqe *)ur->sqes)[index];
+  memset(sqe, 0, sizeof(*sqe));
+
+  sqe->opcode = ur->fixed_buffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t)ur->config.buffers[buffer_index];
+  sqe->len = len;
+  sqe->off = (uint64_t)-1; // Current position, as required for pipes and character devices.
+  sqe->buf_index = ur->fixed_buffers ? buffer_index : 0;
+  sqe->user_data = buffer_index;
+
+  ur->sq_array[index] = index;
+  __atomic_store_n(ur->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ur->queued++;
+  ur->buffer_states[buffer_index] = BUFFER_IN_FLIGHT;
+  ur->queued_lens[buffer_index] = len;
+  ur->queued_fds[buffer_index] = fd;
+
+  return 0;
+}
+
+int ws2812b_uring_submit(ws2812b_uring_t *ur) {
+  if (ur->queued == 0) {
+    return 0;
+  }
+
+  int ret;
+  do {
+    ret = syscall(__NR_io_uring_enter, ur->ring_fd, ur->queued, 0, 0, NULL, 0);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret < 0) {
+    return -1;
+  }
+
+  ur->queued -= ret;
+  ur->in_flight += ret;
+  return ret;
+}
+
+int ws2812b_uring_reap(ws2812b_uring_t *ur, uint32_t min_complete) {
+  // Never wait for more completions than there are writes in flight.
+  if (min_complete > ur->in_flight + ur->queued) {
+    min_complete = ur->in_flight + ur->queued;
+  }
+
+  uint32_t reaped = 0;
+
+  while (1) {
+    // Only this thread consumes completions, only the kernel produces them.
+    uint32_t head = *ur->cq_head;
+    uint32_t tail = __atomic_load_n(ur->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+      struct io_uring_cqe *cqe = &((struct io_uring_cqe *)ur->cqes)[head & *ur->cq_mask];
+      uint32_t buffer_index = cqe->user_data;
+      int result = cqe->res;
+      head++;
+
+      // A short write sent a partial frame to the strip.
+      if (result >= 0 && (uint32_t)result != ur->queued_lens[buffer_index]) {
+        result = -EIO;
+      }
+      if (result < 0) {
+        ur->errors++;
+        ur->last_error = -result;
+      }
+      ur->completed++;
+      ur->in_flight--;
+      reaped++;
+
+      // Recycle buffer
+      ur->buffer_states[buffer_index] = BUFFER_FREE;
+      ur->free_buffers[ur->free_count] = buffer_index;
+      ur->free_count++;
+
+      if (ur->config.on_complete != 0) {
+        ur->config.on_complete(ur->config.ctx, buffer_index, result);
+      }
+    }
+
+    __atomic_store_n(ur->cq_head, head, __ATOMIC_RELEASE);
+
+    if (reaped >= min_complete) {
+      return reaped;
+    }
+
+    // Wait for more completions. Any writes still queued are submitted as well.
+    int ret = syscall(__NR_io_uring_enter, ur->ring_fd, ur->queued, min_complete - reaped,
+                      IORING_ENTER_GETEVENTS, NULL, 0);
+    if (ret < 0 && errno != EINTR) {
+      return -1;
+    }
+    if (ret > 0) {
+      ur->queued -= ret;
+      ur->in_flight += ret;
+    }
+  }
+}
+
+// ======== Private Functions ======================================================================
+
+static int map_rings(ws2812b_uring_t *ur, struct io_uring_params *p) {
+  ur->sq_map_len = p->sq_off.array + p->sq_entries * sizeof(uint32_t);
+  ur->cq_map_len = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+  ur->sqes_map_len = p->sq_entries * sizeof(struct io_uring_sqe);
+
+  // Newer kernels map both rings with a single mmap.
+  bool single_mmap = p->features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    if (ur->cq_map_len > ur->sq_map_len) {
+      ur->sq_map_len = ur->cq_map_len;
+    }
+    ur->cq_map_len = ur->sq_map_len;
+  }
+
+  ur->sq_map = mmap(0, ur->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ur->ring_fd, IORING_OFF_SQ_RING);
+  if (ur->sq_map == MAP_FAILED) {
+    return -1;
+  }
+
+  if (single_mmap) {
+    ur->cq_map = ur->sq_map;
+  } else {
+    ur->cq_map = mmap(0, ur->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ur->ring_fd, IORING_OFF_CQ_RING);
+    if (ur->cq_map == MAP_FAILED) {
+      return -1;
+    }
+  }
+
+  ur->sqes = mmap(0, ur->sqes_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ur->ring_fd, IORING_OFF_SQES);
+  if (ur->sqes == MAP_FAILED) {
+    return -1;
+  }
+
+  uint8_t *sq = ur->sq_map;
+  ur->sq_head = (uint32_t *)(sq + p->sq_off.head);
+  ur->sq_tail = (uint32_t *)(sq + p->sq_off.tail);
+  ur->sq_mask = (uint32_t *)(sq + p->sq_off.ring_mask);
+  ur->sq_array = (uint32_t *)(sq + p->sq_off.array);
+  ur->sq_entries = p->sq_entries;
+
+  uint8_t *cq = ur->cq_map;
+  ur->cq_head = (uint32_t *)(cq + p->cq_off.head);
+  ur->cq_tail = (uint32_t *)(cq + p->cq_off.tail);
+  ur->cq_mask = (uint32_t *)(cq + p->cq_off.ring_mask);
+  ur->cqes = cq + p->cq_off.cqes;
+
+  return 0;
+}
+
+static void register_buffers(ws2812b_uring_t *ur) {
+  // Registered (fixed) buffers are mapped into the kernel once, instead of on every write.
+  // If registration fails (for example due to RLIMIT_MEMLOCK), regular writes are used.
+  ur->fixed_buffers = false;
+
+  struct iovec *iov = malloc(sizeof(struct iovec) * ur->config.buffer_count);
+  if (iov == 0) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < ur->config.buffer_count; i++) {
+    iov[i].iov_base = ur->config.buffers[i];
+    iov[i].iov_len = ur->config.buffer_len;
+  }
+
+  if (syscall(__NR_io_uring_register, ur->ring_fd, IORING_REGISTER_BUFFERS, iov,
+              ur->config.buffer_count) == 0) {
+    ur->fixed_buffers = true;
+  }
+
+  free(iov);
+}
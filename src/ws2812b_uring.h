@@ -0,0 +1,72 @@
+/*
+ * ws2812b_uring.h
+ *
+ *  Linux io_uring based asynchronous frame writer for buffers generated by the ws2812b driver.
+ */
+
+#ifndef INC_WS2812B_URING_H_
+#define INC_WS2812B_URING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Called for every completed write.
+// result is the number of bytes written, or a negative errno value. Short writes are reported
+// as -EIO.
+typedef void (*ws2812b_uring_complete_t)(void *ctx, uint32_t buffer_index, int result);
+
+typedef struct {
+  uint8_t **buffers;                    // Frame buffers.
+  uint32_t buffer_count;                // Number of frame buffers.
+  uint32_t buffer_len;                  // Length of each frame buffer.
+  ws2812b_uring_complete_t on_complete; // Optional completion callback.
+  void *ctx;                            // Passed to on_complete.
+} ws2812b_uring_config_t;
+
+typedef struct {
+  ws2812b_uring_config_t config;
+
+  // Ring, set by init.
+  int ring_fd;
+  uint32_t *sq_head;
+  uint32_t *sq_tail;
+  uint32_t *sq_mask;
+  uint32_t *sq_array;
+  uint32_t sq_entries;
+  void *sqes;
+  uint32_t *cq_head;
+  uint32_t *cq_tail;
+  uint32_t *cq_mask;
+  void *cqes;
+  void *sq_map;
+  size_t sq_map_len;
+  void *cq_map;
+  size_t cq_map_len;
+  size_t sqes_map_len;
+  bool fixed_buffers;
+
+  // Buffers not currently queued or in flight, set by init.
+  uint32_t *free_buffers;
+  uint32_t free_count;
+  uint8_t *buffer_states; // State of every buffer: free, acquired or queued/in flight.
+  uint32_t *queued_lens;  // Length of the write queued for every buffer.
+  int *queued_fds;        // File descriptor of the write queued for every buffer.
+  uint32_t queued;
+  uint32_t in_flight;
+
+  // Statistics
+  uint64_t completed;
+  uint64_t errors;
+  int last_error;
+} ws2812b_uring_t;
+
+int ws2812b_uring_init(ws2812b_uring_t *ur);
+void ws2812b_uring_close(ws2812b_uring_t *ur);
+
+int ws2812b_uring_acquire(ws2812b_uring_t *ur);
+int ws2812b_uring_queue(ws2812b_uring_t *ur, int fd, uint32_t buffer_index, uint32_t len);
+int ws2812b_uring_submit(ws2812b_uring_t *ur);
+int ws2812b_uring_reap(ws2812b_uring_t *ur, uint32_t min_complete);
+
+#endif /* INC_WS2812B_URING_H_ */
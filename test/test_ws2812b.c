@@ -1,3 +1,4 @@
+#include "math.h"
 #include "stdlib.h"
 #include "string.h"
 #include "unity.h"
@@ -99,6 +100,67 @@ bool util_test_driver_output(ws2812b_handle_t *h, uint8_t *buf_data_expected) {
   return true;
 }
 
+void util_init_handle(ws2812b_handle_t *h, ws2812b_led_t *leds, uint32_t led_count,
+                      ws2812b_packing_t packing) {
+  h->led_count = led_count;
+  h->leds = leds;
+  h->config.packing = packing;
+  h->config.pulse_len_0 = WS2812B_PULSE_LEN_1b;
+  h->config.pulse_len_1 = WS2812B_PULSE_LEN_2b;
+  h->config.first_bit_0 = WS2812B_FIRST_BIT_0_ENABLED;
+  h->config.spi_bit_order = WS2812B_MSB_FIRST;
+  h->config.prefix_len = 1;
+  h->config.suffix_len = 4;
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(h), "Init function failed!");
+}
+
+void util_random_leds(ws2812b_led_t *leds, uint32_t led_count, uint32_t seed) {
+  srand(seed);
+  for (uint32_t i = 0; i < led_count; i++) {
+    leds[i].red = rand();
+    leds[i].green = rand();
+    leds[i].blue = rand();
+  }
+}
+
+// Assert that the buffer and iterator output of h match the output of the reference handle.
+void util_assert_same_output(ws2812b_handle_t *reference, ws2812b_handle_t *h) {
+  uint32_t len = ws2812b_required_buffer_len(h);
+  TEST_ASSERT_EQUAL_UINT32(ws2812b_required_buffer_len(reference), len);
+
+  uint8_t *expected = malloc(len);
+  uint8_t *buf = malloc(len);
+  ws2812b_fill_buffer(reference, expected);
+
+  memset(buf, 0x55, len);
+  ws2812b_fill_buffer(h, buf);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+
+  util_generate_iter_buf(h, buf);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+
+  free(buf);
+  free(expected);
+}
+
+// Decode the colors from a single packing buffer.
+void util_decode_leds(ws2812b_handle_t *h, const uint8_t *buf, ws2812b_led_t *leds) {
+  const uint8_t *data = &buf[h->config.prefix_len];
+  for (uint32_t i = 0; i < h->led_count; i++) {
+    uint8_t color[3] = {0};
+    for (uint32_t c = 0; c < 3; c++) {
+      for (uint32_t b = 0; b < 8; b++) {
+        if (data[24 * i + 8 * c + b] == h->state.pulse_1) {
+          color[c] |= 0x80 >> b;
+        }
+      }
+    }
+    leds[i].green = color[0];
+    leds[i].red = color[1];
+    leds[i].blue = color[2];
+  }
+}
+
 // ======== Tests ==================================================================================
 
 void test_no_vla(void) {
@@ -625,6 +687,1816 @@ void test_spi_bit_order(void) {
                            test_error_msg);
 }
 
+void test_segments(void) {
+  ws2812b_led_t leds[3];
+  memset(leds, 0xa5, sizeof(leds));
+  leds[1].green = 0x00;
+
+  ws2812b_handle_t h;
+  h.led_count = 3;
+  h.leds = leds;
+  h.config.packing = WS2812B_PACKING_SINGLE;
+  h.config.pulse_len_0 = WS2812B_PULSE_LEN_2b;
+  h.config.pulse_len_1 = WS2812B_PULSE_LEN_6b;
+  h.config.first_bit_0 = WS2812B_FIRST_BIT_0_ENABLED;
+  h.config.spi_bit_order = WS2812B_MSB_FIRST;
+  h.config.prefix_len = 1;
+  h.config.suffix_len = 2 * WS2812B_ZERO_BLOCK_LEN + 3;
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&h), "Init function failed!");
+
+  // Reference buffer
+  uint32_t buf_len = ws2812b_required_buffer_len(&h);
+  uint8_t *buf = malloc(buf_len);
+  ws2812b_fill_buffer(&h, buf);
+
+  // Segments
+  uint8_t data[WS2812B_DATA_LEN(3, WS2812B_PACKING_SINGLE)];
+  ws2812b_segment_t segments[WS2812B_REQUIRED_SEGMENT_COUNT(1, 2 * WS2812B_ZERO_BLOCK_LEN + 3)];
+  uint32_t segment_count = ws2812b_fill_segments(&h, data, segments);
+  TEST_ASSERT_EQUAL_UINT32(5, segment_count);
+
+  // Data segment points into data buffer, padding segments into the same shared block:
+  TEST_ASSERT_EQUAL_PTR(data, segments[1].ptr);
+  TEST_ASSERT_EQUAL_PTR(segments[0].ptr, segments[2].ptr);
+  TEST_ASSERT_EQUAL_PTR(segments[0].ptr, segments[4].ptr);
+  TEST_ASSERT_EQUAL_UINT32(WS2812B_ZERO_BLOCK_LEN, segments[2].len);
+  TEST_ASSERT_EQUAL_UINT32(3, segments[4].len);
+
+  // Concatenated segments must match the buffer
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < segment_count; i++) {
+    TEST_ASSERT_TRUE(offset + segments[i].len <= buf_len);
+    TEST_ASSERT_EQUAL_MEMORY(&buf[offset], segments[i].ptr, segments[i].len);
+    offset += segments[i].len;
+  }
+  TEST_ASSERT_EQUAL_UINT32(buf_len, offset);
+
+  // No LEDs and no prefix: only the suffix is left
+  h.led_count = 0;
+  h.config.prefix_len = 0;
+  h.config.suffix_len = 4;
+  TEST_ASSERT_EQUAL_UINT32(1, ws2812b_fill_segments(&h, data, segments));
+  TEST_ASSERT_EQUAL_UINT32(4, segments[0].len);
+
+  free(buf);
+}
+
+void test_chain(void) {
+  ws2812b_led_t leds_a[2] = {{0x12, 0x34, 0x56}, {0xff, 0x00, 0x81}};
+  ws2812b_led_t leds_c[1] = {{0xaa, 0x55, 0x0f}};
+
+  ws2812b_handle_t a, b, c;
+  a.led_count = 2;
+  a.leds = leds_a;
+  a.config.packing = WS2812B_PACKING_SINGLE;
+  a.config.pulse_len_0 = WS2812B_PULSE_LEN_2b;
+  a.config.pulse_len_1 = WS2812B_PULSE_LEN_6b;
+  a.config.first_bit_0 = WS2812B_FIRST_BIT_0_ENABLED;
+  a.config.spi_bit_order = WS2812B_MSB_FIRST;
+  a.config.prefix_len = 2;
+  a.config.suffix_len = 100; // Ignored, not the last handle.
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&a), "Init function failed!");
+
+  // Handle without LEDs in the middle of the chain
+  b = a;
+  b.led_count = 0;
+  b.leds = 0;
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&b), "Init function failed!");
+
+  c = a;
+  c.led_count = 1;
+  c.leds = leds_c;
+  c.config.prefix_len = 100; // Ignored, not the first handle.
+  c.config.suffix_len = 3;
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&c), "Init function failed!");
+
+  ws2812b_handle_t *handles[] = {&a, &b, &c};
+
+  uint32_t len = ws2812b_chain_required_buffer_len(handles, 3);
+  TEST_ASSERT_EQUAL_UINT32(WS2812B_REQUIRED_BUFFER_LEN(3, WS2812B_PACKING_SINGLE, 2, 3), len);
+
+  // Expected: prefix of a, data of a and c, suffix of c
+  uint8_t expected[WS2812B_REQUIRED_BUFFER_LEN(3, WS2812B_PACKING_SINGLE, 2, 3)] = {0};
+  ws2812b_fill_data(&a, &expected[2]);
+  ws2812b_fill_data(&c, &expected[2 + WS2812B_DATA_LEN(2, WS2812B_PACKING_SINGLE)]);
+
+  uint8_t buf[WS2812B_REQUIRED_BUFFER_LEN(3, WS2812B_PACKING_SINGLE, 2, 3)];
+  memset(buf, 0x55, sizeof(buf));
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_fill_chain(handles, 3, buf));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+
+  // Chained iterator
+  ws2812b_chain_t chain = {.handles = handles, .count = 3};
+  ws2812b_chain_iter_restart(&chain);
+
+  for (uint32_t i = 0; i < len; i++) {
+    TEST_ASSERT_FALSE(ws2812b_chain_iter_is_finished(&chain));
+    TEST_ASSERT_EQUAL_HEX8(expected[i], ws2812b_chain_iter_next(&chain));
+  }
+  TEST_ASSERT_TRUE(ws2812b_chain_iter_is_finished(&chain));
+  TEST_ASSERT_EQUAL_HEX8(0, ws2812b_chain_iter_next(&chain));
+
+  // Same with double packing
+  a.config.packing = WS2812B_PACKING_DOUBLE;
+  a.config.pulse_len_1 = WS2812B_PULSE_LEN_2b;
+  a.config.pulse_len_0 = WS2812B_PULSE_LEN_1b;
+  b.config = a.config;
+  c.config = a.config;
+  c.config.suffix_len = 3;
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&a), "Init function failed!");
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&b), "Init function failed!");
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&c), "Init function failed!");
+
+  len = ws2812b_chain_required_buffer_len(handles, 3);
+  TEST_ASSERT_EQUAL_UINT32(WS2812B_REQUIRED_BUFFER_LEN(3, WS2812B_PACKING_DOUBLE, 2, 3), len);
+
+  memset(expected, 0, sizeof(expected));
+  ws2812b_fill_data(&a, &expected[2]);
+  ws2812b_fill_data(&c, &expected[2 + WS2812B_DATA_LEN(2, WS2812B_PACKING_DOUBLE)]);
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_fill_chain(handles, 3, buf));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+
+  // Handles that encode bits differently can not share a frame. Nothing is written.
+  ws2812b_config_t shared = c.config;
+  ws2812b_config_t mismatched[4] = {shared, shared, shared, shared};
+  mismatched[0].packing = WS2812B_PACKING_SINGLE;
+  mismatched[1].pulse_len_1 = WS2812B_PULSE_LEN_3b;
+  mismatched[2].first_bit_0 = WS2812B_FIRST_BIT_0_DISABLED;
+  mismatched[3].spi_bit_order = WS2812B_LSB_FIRST;
+  for (uint32_t m = 0; m < 4; m++) {
+    c.config = mismatched[m];
+    TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&c), "Init function failed!");
+    memset(buf, 0x55, sizeof(buf));
+    TEST_ASSERT_EQUAL_INT(-1, ws2812b_fill_chain(handles, 3, buf));
+    TEST_ASSERT_EQUAL_HEX8(0x55, buf[0]);
+    TEST_ASSERT_EQUAL_INT(-1, ws2812b_chain_iter_restart(&chain));
+    TEST_ASSERT_TRUE(ws2812b_chain_iter_is_finished(&chain));
+    TEST_ASSERT_EQUAL_HEX8(0, ws2812b_chain_iter_next(&chain));
+  }
+  c.config = shared;
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&c), "Init function failed!");
+
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_chain_iter_restart(&chain));
+  for (uint32_t i = 0; i < len; i++) {
+    TEST_ASSERT_FALSE(ws2812b_chain_iter_is_finished(&chain));
+    TEST_ASSERT_EQUAL_HEX8(expected[i], ws2812b_chain_iter_next(&chain));
+  }
+  TEST_ASSERT_TRUE(ws2812b_chain_iter_is_finished(&chain));
+
+  // An empty chain is always finished
+  chain.count = 0;
+  ws2812b_chain_iter_restart(&chain);
+  TEST_ASSERT_TRUE(ws2812b_chain_iter_is_finished(&chain));
+  TEST_ASSERT_EQUAL_UINT32(0, ws2812b_chain_required_buffer_len(handles, 0));
+}
+
+#define INPLACE_LED_COUNT 20
+void test_inplace(void) {
+  ws2812b_led_t leds[INPLACE_LED_COUNT];
+  for (uint32_t i = 0; i < INPLACE_LED_COUNT; i++) {
+    leds[i].red = i * 13;
+    leds[i].green = 0xff - i * 7;
+    leds[i].blue = i * i;
+  }
+
+  ws2812b_handle_t h;
+  h.led_count = INPLACE_LED_COUNT;
+  h.config.pulse_len_0 = WS2812B_PULSE_LEN_1b;
+  h.config.pulse_len_1 = WS2812B_PULSE_LEN_2b;
+  h.config.first_bit_0 = WS2812B_FIRST_BIT_0_ENABLED;
+  h.config.spi_bit_order = WS2812B_LSB_FIRST;
+
+  uint8_t expected[WS2812B_REQUIRED_BUFFER_LEN(INPLACE_LED_COUNT, WS2812B_PACKING_SINGLE, 3, 5)];
+  uint8_t buf[WS2812B_INPLACE_BUFFER_LEN(INPLACE_LED_COUNT, WS2812B_PACKING_SINGLE, 3, 5)];
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  uint32_t suffixes[] = {0, 5};
+
+  for (uint32_t p = 0; p < 2; p++) {
+    for (uint32_t s = 0; s < 2; s++) {
+      h.config.packing = packings[p];
+      h.config.prefix_len = 3;
+      h.config.suffix_len = suffixes[s];
+      TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&h), "Init function failed!");
+      uint32_t len = ws2812b_required_buffer_len(&h);
+
+      // Reference, using separate LED array
+      h.leds = leds;
+      ws2812b_fill_buffer(&h, expected);
+
+      // In-place
+      memset(buf, 0x55, sizeof(buf));
+      ws2812b_led_t *view = ws2812b_inplace_leds(&h, buf);
+      TEST_ASSERT_EQUAL_PTR(view, h.leds);
+      TEST_ASSERT_TRUE((uint8_t *)view >= buf);
+      TEST_ASSERT_EQUAL_PTR(&buf[len], &view[INPLACE_LED_COUNT]);
+      memcpy(view, leds, sizeof(leds));
+
+      ws2812b_fill_buffer(&h, buf);
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+    }
+  }
+}
+
+#define LARGE_LED_COUNT 300
+void test_large_buffer(void) {
+  // Large enough to use the streaming path if enabled (see makefile). Checked against the
+  // iterator, at different buffer alignments.
+  ws2812b_led_t *leds = malloc(sizeof(ws2812b_led_t) * LARGE_LED_COUNT);
+  srand(1);
+  for (uint32_t i = 0; i < LARGE_LED_COUNT; i++) {
+    leds[i].red = rand();
+    leds[i].green = rand();
+    leds[i].blue = rand();
+  }
+
+  ws2812b_handle_t h;
+  h.led_count = LARGE_LED_COUNT;
+  h.leds = leds;
+  h.config.pulse_len_0 = WS2812B_PULSE_LEN_1b;
+  h.config.pulse_len_1 = WS2812B_PULSE_LEN_2b;
+  h.config.first_bit_0 = WS2812B_FIRST_BIT_0_ENABLED;
+  h.config.spi_bit_order = WS2812B_MSB_FIRST;
+  h.config.prefix_len = 3;
+  h.config.suffix_len = 4;
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+
+  for (uint32_t p = 0; p < 2; p++) {
+    h.config.packing = packings[p];
+    TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&h), "Init function failed!");
+    uint32_t len = ws2812b_required_buffer_len(&h);
+
+    uint8_t *iter_buf = malloc(len);
+    uint8_t *buf = malloc(len + 16);
+    util_generate_iter_buf(&h, iter_buf);
+
+    for (uint32_t offset = 0; offset < 16; offset += 5) {
+      memset(buf, 0x55, len + 16);
+      ws2812b_fill_buffer(&h, &buf[offset]);
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(iter_buf, &buf[offset], len);
+    }
+
+    free(buf);
+    free(iter_buf);
+  }
+
+  free(leds);
+}
+
+#define CLEAN_MAX_CALLS 4
+uint32_t clean_call_count;
+uintptr_t clean_call_ptr[CLEAN_MAX_CALLS];
+uint32_t clean_call_len[CLEAN_MAX_CALLS];
+
+void mock_clean_range(void *ptr, uint32_t len) {
+  if (clean_call_count < CLEAN_MAX_CALLS) {
+    clean_call_ptr[clean_call_count] = (uintptr_t)ptr;
+    clean_call_len[clean_call_count] = len;
+  }
+  clean_call_count++;
+}
+
+// Assert that exactly one range was cleaned, and that it is the smallest range of whole
+// cache lines covering [start, start + len).
+void assert_cleaned(uint8_t *start, uint32_t len, uint32_t line) {
+  uintptr_t first = (uintptr_t)start / line * line;
+  uintptr_t end = ((uintptr_t)start + len + line - 1) / line * line;
+
+  TEST_ASSERT_EQUAL_UINT32(1, clean_call_count);
+  TEST_ASSERT_EQUAL_PTR(first, clean_call_ptr[0]);
+  TEST_ASSERT_EQUAL_UINT32(end - first, clean_call_len[0]);
+  TEST_ASSERT_EQUAL_UINT32(0, clean_call_ptr[0] % line);
+  TEST_ASSERT_EQUAL_UINT32(0, clean_call_len[0] % line);
+  TEST_ASSERT_TRUE(clean_call_ptr[0] <= (uintptr_t)start);
+  TEST_ASSERT_TRUE(clean_call_ptr[0] + line > (uintptr_t)start);
+  TEST_ASSERT_TRUE(clean_call_ptr[0] + clean_call_len[0] >= (uintptr_t)start + len);
+  TEST_ASSERT_TRUE(clean_call_ptr[0] + clean_call_len[0] < (uintptr_t)start + len + line);
+  clean_call_count = 0;
+}
+
+void test_clean_hook(void) {
+  ws2812b_led_t leds[5];
+  memset(leds, 0x3c, sizeof(leds));
+
+  ws2812b_handle_t h;
+  h.led_count = 5;
+  h.leds = leds;
+  h.config.packing = WS2812B_PACKING_DOUBLE;
+  h.config.pulse_len_0 = WS2812B_PULSE_LEN_1b;
+  h.config.pulse_len_1 = WS2812B_PULSE_LEN_2b;
+  h.config.first_bit_0 = WS2812B_FIRST_BIT_0_ENABLED;
+  h.config.spi_bit_order = WS2812B_MSB_FIRST;
+  h.config.prefix_len = 1;
+  h.config.suffix_len = 4;
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&h), "Init function failed!");
+
+  // Invalid line lengths are rejected
+  TEST_ASSERT_TRUE(ws2812b_set_clean_hook(&h, mock_clean_range, 0));
+  TEST_ASSERT_TRUE(ws2812b_set_clean_hook(&h, mock_clean_range, 24));
+
+  uint8_t buf[128 + WS2812B_REQUIRED_BUFFER_LEN(5, WS2812B_PACKING_DOUBLE, 1, 4)];
+  uint32_t len = ws2812b_required_buffer_len(&h);
+  uint32_t data_len = WS2812B_DATA_LEN(5, WS2812B_PACKING_DOUBLE);
+  uint32_t lines[] = {1, 4, 32, 64};
+
+  clean_call_count = 0;
+  for (uint32_t l = 0; l < 4; l++) {
+    TEST_ASSERT_FALSE(ws2812b_set_clean_hook(&h, mock_clean_range, lines[l]));
+
+    for (uint32_t offset = 0; offset < 64; offset += 7) {
+      // Whole buffer
+      ws2812b_fill_buffer(&h, &buf[offset]);
+      assert_cleaned(&buf[offset], len, lines[l]);
+
+      // Solid fills clean prefix, LEDs and suffix as one range, even for a part of the LEDs
+      ws2812b_fill_solid(&h, &buf[offset], (ws2812b_led_t){1, 2, 3}, 0, 5);
+      assert_cleaned(&buf[offset], len, lines[l]);
+      ws2812b_fill_solid(&h, &buf[offset], (ws2812b_led_t){1, 2, 3}, 2, 1);
+      assert_cleaned(&buf[offset], len, lines[l]);
+
+      // Only data is written by these:
+      ws2812b_fill_data(&h, &buf[offset]);
+      assert_cleaned(&buf[offset], data_len, lines[l]);
+
+      ws2812b_segment_t segments[WS2812B_REQUIRED_SEGMENT_COUNT(1, 4)];
+      ws2812b_fill_segments(&h, &buf[offset], segments);
+      assert_cleaned(&buf[offset], data_len, lines[l]);
+
+      // Chain is cleaned as one range
+      ws2812b_handle_t *handles[] = {&h, &h};
+      uint32_t chain_len = ws2812b_chain_required_buffer_len(handles, 2);
+      ws2812b_fill_chain(handles, 2, &buf[offset]);
+      assert_cleaned(&buf[offset], chain_len, lines[l]);
+    }
+  }
+
+  // Nothing written, nothing cleaned
+  h.led_count = 0;
+  ws2812b_fill_data(&h, buf);
+  TEST_ASSERT_EQUAL_UINT32(0, clean_call_count);
+
+  // Init removes the hook
+  h.led_count = 5;
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&h), "Init function failed!");
+  ws2812b_fill_buffer(&h, buf);
+  TEST_ASSERT_EQUAL_UINT32(0, clean_call_count);
+}
+
+#define CURVE_LED_COUNT 40
+void test_color_curves(void) {
+  ws2812b_led_t leds[CURVE_LED_COUNT];
+  ws2812b_led_t corrected[CURVE_LED_COUNT];
+  util_random_leds(leds, CURVE_LED_COUNT, 2);
+
+  uint8_t red_curve[256];
+  uint8_t green_curve[256];
+  ws2812b_generate_color_curve(red_curve, 2.2f, 200);
+  for (uint32_t i = 0; i < 256; i++) {
+    green_curve[i] = 255 - i;
+  }
+
+  // Blue has no curve, and is passed through unchanged.
+  for (uint32_t i = 0; i < CURVE_LED_COUNT; i++) {
+    corrected[i].red = red_curve[leds[i].red];
+    corrected[i].green = green_curve[leds[i].green];
+    corrected[i].blue = leds[i].blue;
+  }
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t p = 0; p < 2; p++) {
+    ws2812b_handle_t h, reference;
+    util_init_handle(&reference, corrected, CURVE_LED_COUNT, packings[p]);
+    util_init_handle(&h, leds, CURVE_LED_COUNT, packings[p]);
+
+    TEST_ASSERT_FALSE(ws2812b_set_color_curve(&h, WS2812B_CHANNEL_RED, red_curve));
+    TEST_ASSERT_FALSE(ws2812b_set_color_curve(&h, WS2812B_CHANNEL_GREEN, green_curve));
+    util_assert_same_output(&reference, &h);
+
+    // Removing all curves restores the uncorrected output
+    ws2812b_set_color_curve(&h, WS2812B_CHANNEL_RED, 0);
+    ws2812b_set_color_curve(&h, WS2812B_CHANNEL_GREEN, 0);
+    util_init_handle(&reference, leds, CURVE_LED_COUNT, packings[p]);
+    util_assert_same_output(&reference, &h);
+
+    // Init removes all curves
+    ws2812b_set_color_curve(&h, WS2812B_CHANNEL_BLUE, green_curve);
+    TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&h), "Init function failed!");
+    util_assert_same_output(&reference, &h);
+  }
+
+  ws2812b_handle_t h;
+  util_init_handle(&h, leds, CURVE_LED_COUNT, WS2812B_PACKING_SINGLE);
+  TEST_ASSERT_TRUE(ws2812b_set_color_curve(&h, (ws2812b_channel_t)3, red_curve));
+
+  // Generated curves
+  uint8_t curve[256];
+  ws2812b_generate_color_curve(curve, 1.0f, 255);
+  for (uint32_t i = 0; i < 256; i++) {
+    TEST_ASSERT_EQUAL_UINT8(i, curve[i]);
+  }
+
+  ws2812b_generate_color_curve(curve, 1.0f, 128);
+  TEST_ASSERT_EQUAL_UINT8(0, curve[0]);
+  TEST_ASSERT_EQUAL_UINT8(64, curve[127]);
+  TEST_ASSERT_EQUAL_UINT8(128, curve[255]);
+
+  ws2812b_generate_color_curve(curve, 2.2f, 255);
+  TEST_ASSERT_EQUAL_UINT8(0, curve[0]);
+  TEST_ASSERT_EQUAL_UINT8(56, curve[128]);
+  TEST_ASSERT_EQUAL_UINT8(255, curve[255]);
+  for (uint32_t i = 1; i < 256; i++) {
+    TEST_ASSERT_TRUE(curve[i] >= curve[i - 1]);
+  }
+}
+
+#define LED16_LED_COUNT 40
+void test_led16_dithering(void) {
+  // Two full blocks and a partial one.
+  ws2812b_led16_t leds[LED16_LED_COUNT];
+  srand(3);
+  for (uint32_t i = 0; i < LED16_LED_COUNT; i++) {
+    leds[i].red = rand();
+    leds[i].green = rand();
+    leds[i].blue = rand();
+  }
+  leds[0].red = 0xFFFF;
+  leds[1].green = 0xFF80;
+  leds[2].blue = 0;
+  leds[20].red = 0xFFFF;
+  leds[21].green = 0x00FF;
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t p = 0; p < 2; p++) {
+    ws2812b_handle_t buffered, iterated, reference;
+    ws2812b_led_t buffered_errors[LED16_LED_COUNT];
+    ws2812b_led_t iterated_errors[LED16_LED_COUNT];
+    util_init_handle(&buffered, 0, LED16_LED_COUNT, packings[p]);
+    util_init_handle(&iterated, 0, LED16_LED_COUNT, packings[p]);
+    ws2812b_set_source_led16(&buffered, leds, buffered_errors);
+    ws2812b_set_source_led16(&iterated, leds, iterated_errors);
+
+    // Reference dithering, with saturating sums:
+    ws2812b_led_t expected[LED16_LED_COUNT];
+    uint32_t errors[LED16_LED_COUNT][3] = {{0}};
+    util_init_handle(&reference, expected, LED16_LED_COUNT, packings[p]);
+
+    uint32_t len = ws2812b_required_buffer_len(&reference);
+    uint8_t *expected_buf = malloc(len);
+    uint8_t *buf = malloc(len);
+
+    for (uint32_t frame = 0; frame < 8; frame++) {
+      for (uint32_t i = 0; i < LED16_LED_COUNT; i++) {
+        uint16_t values[3] = {leds[i].red, leds[i].green, leds[i].blue};
+        uint8_t out[3];
+        for (uint32_t c = 0; c < 3; c++) {
+          uint32_t sum = values[c] + errors[i][c];
+          sum = sum > 0xFFFF ? 0xFFFF : sum;
+          out[c] = sum >> 8;
+          errors[i][c] = sum & 0xFF;
+        }
+        expected[i].red = out[0];
+        expected[i].green = out[1];
+        expected[i].blue = out[2];
+      }
+      ws2812b_fill_buffer(&reference, expected_buf);
+
+      ws2812b_fill_buffer(&buffered, buf);
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_buf, buf, len);
+
+      util_generate_iter_buf(&iterated, buf);
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_buf, buf, len);
+    }
+
+    // Without error accumulators, values are rounded
+    for (uint32_t i = 0; i < LED16_LED_COUNT; i++) {
+      expected[i].red = leds[i].red > 0xFF7F ? 0xFF : (leds[i].red + 0x80) >> 8;
+      expected[i].green = leds[i].green > 0xFF7F ? 0xFF : (leds[i].green + 0x80) >> 8;
+      expected[i].blue = leds[i].blue > 0xFF7F ? 0xFF : (leds[i].blue + 0x80) >> 8;
+    }
+    ws2812b_set_source_led16(&buffered, leds, 0);
+    util_assert_same_output(&reference, &buffered);
+
+    free(buf);
+    free(expected_buf);
+  }
+
+  // Over 256 frames, the output adds up to the 16-bit value:
+  ws2812b_led16_t led = {0x1234, 0x0001, 0xFF00};
+  ws2812b_led_t error;
+  ws2812b_handle_t h;
+  util_init_handle(&h, 0, 1, WS2812B_PACKING_SINGLE);
+  ws2812b_set_source_led16(&h, &led, &error);
+
+  uint32_t sums[3] = {0};
+  for (uint32_t frame = 0; frame < 256; frame++) {
+    ws2812b_iter_restart(&h);
+    ws2812b_iter_next(&h); // Prefix
+    for (uint32_t c = 0; c < 3; c++) {
+      uint8_t value = 0;
+      for (uint32_t b = 0; b < 8; b++) {
+        if (ws2812b_iter_next(&h) == h.state.pulse_1) {
+          value |= 0x80 >> b;
+        }
+      }
+      sums[c] += value;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(0x0001, sums[0]); // Green first
+  TEST_ASSERT_EQUAL_UINT32(0x1234, sums[1]);
+  TEST_ASSERT_EQUAL_UINT32(0xFF00, sums[2]);
+}
+
+#define FLOAT_LED_COUNT 43
+double util_half_to_double(uint16_t h) {
+  int exponent = (h >> 10) & 0x1F;
+  double mantissa = h & 0x3FF;
+  double value;
+  if (exponent == 0) {
+    value = ldexp(mantissa, -24);
+  } else if (exponent == 0x1F) {
+    value = mantissa == 0 ? INFINITY : NAN;
+  } else {
+    value = ldexp(mantissa + 1024, exponent - 25);
+  }
+  return (h & 0x8000) ? -value : value;
+}
+
+uint8_t util_reference_quantize(double v, const uint8_t *transfer) {
+  v = v > 0 ? v : 0; // Also catches NaN
+  v = v < 1 ? v : 1;
+  if (transfer != 0) {
+    return transfer[(uint32_t)floor(v * (WS2812B_TRANSFER_CURVE_LEN - 1) + 0.5)];
+  }
+  return (uint8_t)floor(v * 255 + 0.5);
+}
+
+void test_float_source(void) {
+  float planar[3][FLOAT_LED_COUNT];
+  float interleaved[FLOAT_LED_COUNT * 3];
+  uint16_t half_planar[3][FLOAT_LED_COUNT];
+  uint16_t half_interleaved[FLOAT_LED_COUNT * 3];
+  double reference[3][FLOAT_LED_COUNT];
+  double half_reference[3][FLOAT_LED_COUNT];
+
+  srand(4);
+  for (uint32_t c = 0; c < 3; c++) {
+    for (uint32_t i = 0; i < FLOAT_LED_COUNT; i++) {
+      // Mostly in [0, 1], some out of range:
+      planar[c][i] = (rand() % 15000) / 10000.0f - 0.25f;
+      interleaved[3 * i + c] = planar[c][i];
+      reference[c][i] = planar[c][i];
+
+      // Random halves up to 2, including subnormals and negative values:
+      half_planar[c][i] = (rand() & 0x83FF) | (rand() % 17) << 10;
+      half_interleaved[3 * i + c] = half_planar[c][i];
+      half_reference[c][i] = util_half_to_double(half_planar[c][i]);
+    }
+  }
+  planar[0][5] = NAN;
+  interleaved[15] = NAN;
+  reference[0][5] = NAN;
+  half_planar[1][7] = 0x7C00; // Infinity
+  half_interleaved[22] = 0x7C00;
+  half_reference[1][7] = INFINITY;
+  half_planar[2][8] = 0x3C00; // 1.0
+  half_interleaved[26] = 0x3C00;
+  half_reference[2][8] = 1.0;
+
+  uint8_t transfer[WS2812B_TRANSFER_CURVE_LEN];
+  ws2812b_generate_transfer_curve(transfer, 2.2f, 255);
+  TEST_ASSERT_EQUAL_UINT8(0, transfer[0]);
+  TEST_ASSERT_EQUAL_UINT8(12, transfer[WS2812B_TRANSFER_CURVE_LEN / 4]);
+  TEST_ASSERT_EQUAL_UINT8(255, transfer[WS2812B_TRANSFER_CURVE_LEN - 1]);
+
+  ws2812b_float_source_t sources[4] = {
+      {WS2812B_FLOAT_F32, planar[0], planar[1], planar[2], 1, 0},
+      {WS2812B_FLOAT_F32, &interleaved[0], &interleaved[1], &interleaved[2], 3, 0},
+      {WS2812B_FLOAT_F16, half_planar[0], half_planar[1], half_planar[2], 1, 0},
+      {WS2812B_FLOAT_F16, &half_interleaved[0], &half_interleaved[1], &half_interleaved[2], 3, 0},
+  };
+
+  for (uint32_t s = 0; s < 4; s++) {
+    for (uint32_t t = 0; t < 2; t++) {
+      sources[s].transfer = t ? transfer : 0;
+      double(*expected)[FLOAT_LED_COUNT] = sources[s].format == WS2812B_FLOAT_F16 ? half_reference
+                                                                                  : reference;
+
+      ws2812b_handle_t h;
+      util_init_handle(&h, 0, FLOAT_LED_COUNT, WS2812B_PACKING_SINGLE);
+      ws2812b_set_source_float(&h, &sources[s]);
+
+      // Iterator and buffer agree
+      util_assert_same_output(&h, &h);
+
+      // Within one step of the double-precision reference
+      uint8_t buf[WS2812B_REQUIRED_BUFFER_LEN(FLOAT_LED_COUNT, WS2812B_PACKING_SINGLE, 1, 4)];
+      ws2812b_led_t leds[FLOAT_LED_COUNT];
+      ws2812b_fill_buffer(&h, buf);
+      util_decode_leds(&h, buf, leds);
+
+      for (uint32_t i = 0; i < FLOAT_LED_COUNT; i++) {
+        TEST_ASSERT_UINT8_WITHIN(1, util_reference_quantize(expected[0][i], sources[s].transfer),
+                                 leds[i].red);
+        TEST_ASSERT_UINT8_WITHIN(1, util_reference_quantize(expected[1][i], sources[s].transfer),
+                                 leds[i].green);
+        TEST_ASSERT_UINT8_WITHIN(1, util_reference_quantize(expected[2][i], sources[s].transfer),
+                                 leds[i].blue);
+      }
+
+      // Special values are exact
+      TEST_ASSERT_EQUAL_UINT8(0, leds[5].red);
+      if (sources[s].format == WS2812B_FLOAT_F16) {
+        TEST_ASSERT_EQUAL_UINT8(255, leds[7].green);
+        TEST_ASSERT_EQUAL_UINT8(255, leds[8].blue);
+      }
+    }
+  }
+}
+
+void util_assert_hsv(ws2812b_hsv_t hsv, ws2812b_hsv_mode_t mode, uint8_t red, uint8_t green,
+                     uint8_t blue) {
+  ws2812b_handle_t h;
+  uint8_t buf[WS2812B_REQUIRED_BUFFER_LEN(1, WS2812B_PACKING_SINGLE, 1, 4)];
+  ws2812b_led_t led;
+  util_init_handle(&h, 0, 1, WS2812B_PACKING_SINGLE);
+  ws2812b_set_source_hsv(&h, &hsv, mode);
+  ws2812b_fill_buffer(&h, buf);
+  util_decode_leds(&h, buf, &led);
+  TEST_ASSERT_EQUAL_UINT8(red, led.red);
+  TEST_ASSERT_EQUAL_UINT8(green, led.green);
+  TEST_ASSERT_EQUAL_UINT8(blue, led.blue);
+}
+
+#define HSV_LED_COUNT 256
+void test_hsv_source(void) {
+  ws2812b_hsv_t leds[HSV_LED_COUNT];
+  srand(5);
+  for (uint32_t i = 0; i < HSV_LED_COUNT; i++) {
+    leds[i].hue = i;
+    leds[i].saturation = i % 3 ? 255 : rand();
+    leds[i].value = i % 5 ? 255 : rand();
+  }
+
+  // SIMD and portable conversion (buffer and iterator) agree for every hue.
+  ws2812b_hsv_mode_t modes[] = {WS2812B_HSV_SPECTRUM, WS2812B_HSV_RAINBOW};
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t m = 0; m < 2; m++) {
+    for (uint32_t p = 0; p < 2; p++) {
+      ws2812b_handle_t h;
+      util_init_handle(&h, 0, HSV_LED_COUNT, packings[p]);
+      ws2812b_set_source_hsv(&h, leds, modes[m]);
+      util_assert_same_output(&h, &h);
+    }
+  }
+
+  // Spectrum
+  util_assert_hsv((ws2812b_hsv_t){0, 255, 255}, WS2812B_HSV_SPECTRUM, 255, 0, 0);
+  util_assert_hsv((ws2812b_hsv_t){43, 255, 255}, WS2812B_HSV_SPECTRUM, 253, 255, 0);
+  util_assert_hsv((ws2812b_hsv_t){86, 255, 255}, WS2812B_HSV_SPECTRUM, 0, 255, 4);
+  util_assert_hsv((ws2812b_hsv_t){171, 255, 255}, WS2812B_HSV_SPECTRUM, 2, 0, 255);
+  util_assert_hsv((ws2812b_hsv_t){0, 255, 127}, WS2812B_HSV_SPECTRUM, 127, 0, 0);
+
+  // Rainbow
+  util_assert_hsv((ws2812b_hsv_t){0, 255, 255}, WS2812B_HSV_RAINBOW, 255, 0, 0);
+  util_assert_hsv((ws2812b_hsv_t){64, 255, 255}, WS2812B_HSV_RAINBOW, 171, 170, 0);
+  util_assert_hsv((ws2812b_hsv_t){96, 255, 255}, WS2812B_HSV_RAINBOW, 0, 255, 0);
+  util_assert_hsv((ws2812b_hsv_t){160, 255, 255}, WS2812B_HSV_RAINBOW, 0, 0, 255);
+
+  // No saturation is white, no value is black
+  util_assert_hsv((ws2812b_hsv_t){123, 0, 255}, WS2812B_HSV_SPECTRUM, 255, 255, 255);
+  util_assert_hsv((ws2812b_hsv_t){123, 0, 255}, WS2812B_HSV_RAINBOW, 255, 255, 255);
+  util_assert_hsv((ws2812b_hsv_t){123, 200, 0}, WS2812B_HSV_RAINBOW, 0, 0, 0);
+}
+
+#define MATRIX_LED_COUNT 45
+void test_color_matrix(void) {
+  ws2812b_led_t leds[MATRIX_LED_COUNT];
+  ws2812b_led_t corrected[MATRIX_LED_COUNT];
+  util_random_leds(leds, MATRIX_LED_COUNT, 6);
+  leds[0] = (ws2812b_led_t){255, 255, 255};
+  leds[1] = (ws2812b_led_t){0, 0, 0};
+
+  ws2812b_color_matrix_t matrix = {{{3500, 800, -200}, {-300, 4400, 100}, {0, -900, 5000}}};
+
+  uint8_t curve[256];
+  ws2812b_generate_color_curve(curve, 2.0f, 255);
+
+  // Reference: Matrix, then curve (on red only).
+  for (uint32_t i = 0; i < MATRIX_LED_COUNT; i++) {
+    int32_t rgb[3] = {leds[i].red, leds[i].green, leds[i].blue};
+    uint8_t out[3];
+    for (uint32_t row = 0; row < 3; row++) {
+      int32_t v = 0;
+      for (uint32_t col = 0; col < 3; col++) {
+        v += matrix.m[row][col] * rgb[col];
+      }
+      v = (int32_t)floor(v / 4096.0 + 0.5);
+      out[row] = v < 0 ? 0 : (v > 255 ? 255 : v);
+    }
+    corrected[i].red = curve[out[0]];
+    corrected[i].green = out[1];
+    corrected[i].blue = out[2];
+  }
+  TEST_ASSERT_EQUAL_UINT8(255, corrected[0].green); // Clamped
+  TEST_ASSERT_EQUAL_UINT8(0, corrected[1].green);
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t p = 0; p < 2; p++) {
+    ws2812b_handle_t h, reference;
+    util_init_handle(&reference, corrected, MATRIX_LED_COUNT, packings[p]);
+    util_init_handle(&h, leds, MATRIX_LED_COUNT, packings[p]);
+    ws2812b_set_color_matrix(&h, &matrix);
+    ws2812b_set_color_curve(&h, WS2812B_CHANNEL_RED, curve);
+    util_assert_same_output(&reference, &h);
+  }
+
+  // Identity is skipped
+  ws2812b_handle_t h;
+  ws2812b_color_matrix_t identity;
+  util_init_handle(&h, leds, MATRIX_LED_COUNT, WS2812B_PACKING_SINGLE);
+  ws2812b_color_matrix_identity(&identity);
+  ws2812b_set_color_matrix(&h, &identity);
+  TEST_ASSERT_NULL(h.state.color_matrix);
+
+  // White point scales rows
+  ws2812b_color_matrix_white_point(&identity, 255, 128, 0);
+  TEST_ASSERT_EQUAL_INT16(4096, identity.m[0][0]);
+  TEST_ASSERT_EQUAL_INT16(2056, identity.m[1][1]);
+  TEST_ASSERT_EQUAL_INT16(0, identity.m[2][2]);
+  TEST_ASSERT_EQUAL_INT16(0, identity.m[0][1]);
+  ws2812b_set_color_matrix(&h, &identity);
+  TEST_ASSERT_EQUAL_PTR(&identity, h.state.color_matrix);
+
+  ws2812b_led_t white = {255, 255, 255};
+  ws2812b_led_t decoded;
+  uint8_t buf[WS2812B_REQUIRED_BUFFER_LEN(1, WS2812B_PACKING_SINGLE, 1, 4)];
+  h.leds = &white;
+  h.led_count = 1;
+  ws2812b_fill_buffer(&h, buf);
+  util_decode_leds(&h, buf, &decoded);
+  TEST_ASSERT_EQUAL_UINT8(255, decoded.red);
+  TEST_ASSERT_EQUAL_UINT8(128, decoded.green);
+  TEST_ASSERT_EQUAL_UINT8(0, decoded.blue);
+
+  // Init removes the matrix
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&h), "Init function failed!");
+  TEST_ASSERT_NULL(h.state.color_matrix);
+}
+
+#define CALIBRATION_LED_COUNT 37
+void test_calibration(void) {
+  ws2812b_led_t leds[CALIBRATION_LED_COUNT];
+  ws2812b_led_t calibrated[CALIBRATION_LED_COUNT];
+  ws2812b_gain_t gains[CALIBRATION_LED_COUNT];
+  util_random_leds(leds, CALIBRATION_LED_COUNT, 7);
+  util_random_leds((ws2812b_led_t *)gains, CALIBRATION_LED_COUNT, 8);
+  gains[0] = (ws2812b_gain_t){255, 255, 255};
+  leds[0] = (ws2812b_led_t){255, 1, 128};
+  gains[1] = (ws2812b_gain_t){0, 127, 255};
+  leds[1] = (ws2812b_led_t){255, 255, 255};
+
+  for (uint32_t i = 0; i < CALIBRATION_LED_COUNT; i++) {
+    calibrated[i].red = (leds[i].red * (gains[i].red + 1)) >> 8;
+    calibrated[i].green = (leds[i].green * (gains[i].green + 1)) >> 8;
+    calibrated[i].blue = (leds[i].blue * (gains[i].blue + 1)) >> 8;
+  }
+
+  // Full gain is unchanged
+  TEST_ASSERT_EQUAL_MEMORY(&leds[0], &calibrated[0], sizeof(ws2812b_led_t));
+  TEST_ASSERT_EQUAL_UINT8(0, calibrated[1].red);
+  TEST_ASSERT_EQUAL_UINT8(127, calibrated[1].green);
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t p = 0; p < 2; p++) {
+    ws2812b_handle_t h, reference;
+    util_init_handle(&reference, calibrated, CALIBRATION_LED_COUNT, packings[p]);
+    util_init_handle(&h, leds, CALIBRATION_LED_COUNT, packings[p]);
+    ws2812b_set_calibration(&h, gains);
+    util_assert_same_output(&reference, &h);
+
+    // Segment and chain fills use the same calibration
+    uint8_t expected[WS2812B_DATA_LEN(CALIBRATION_LED_COUNT, WS2812B_PACKING_SINGLE)];
+    uint8_t data[WS2812B_DATA_LEN(CALIBRATION_LED_COUNT, WS2812B_PACKING_SINGLE)];
+    ws2812b_segment_t segments[WS2812B_REQUIRED_SEGMENT_COUNT(1, 4)];
+    ws2812b_fill_data(&reference, expected);
+    ws2812b_fill_segments(&h, data, segments);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, data,
+                                 WS2812B_DATA_LEN(CALIBRATION_LED_COUNT, packings[p]));
+
+    // Removed again
+    ws2812b_set_calibration(&h, 0);
+    util_init_handle(&reference, leds, CALIBRATION_LED_COUNT, packings[p]);
+    util_assert_same_output(&reference, &h);
+  }
+}
+
+#define POWER_LED_COUNT 50
+void util_init_power(ws2812b_power_t *power, ws2812b_power_mode_t mode) {
+  power->mode = mode;
+  power->budget_ma = 1000;
+  power->channel_ua[WS2812B_CHANNEL_RED] = 20000;
+  power->channel_ua[WS2812B_CHANNEL_GREEN] = 20000;
+  power->channel_ua[WS2812B_CHANNEL_BLUE] = 20000;
+  power->channel_ua[WS2812B_CHANNEL_WHITE] = 20000;
+  power->idle_ua = 1000;
+}
+
+void test_power_limit(void) {
+  ws2812b_led_t white[POWER_LED_COUNT];
+  ws2812b_led_t limited[POWER_LED_COUNT];
+  memset(white, 0xFF, sizeof(white));
+
+  // 50 * (1mA + 3 * 20mA) = 3050mA. Scale: (1000mA - 50mA) * 256 / 3000mA = 81.
+  memset(limited, (255 * 81) >> 8, sizeof(limited));
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t p = 0; p < 2; p++) {
+    ws2812b_handle_t h, full, reference;
+    ws2812b_power_t power;
+    util_init_handle(&full, white, POWER_LED_COUNT, packings[p]);
+    util_init_handle(&reference, limited, POWER_LED_COUNT, packings[p]);
+    util_init_handle(&h, white, POWER_LED_COUNT, packings[p]);
+
+    uint32_t len = ws2812b_required_buffer_len(&h);
+    uint8_t *expected_full = malloc(len);
+    uint8_t *expected = malloc(len);
+    uint8_t *buf = malloc(len);
+    ws2812b_fill_buffer(&full, expected_full);
+    ws2812b_fill_buffer(&reference, expected);
+
+    // Next frame: The first frame is sent in full, the following ones limited.
+    util_init_power(&power, WS2812B_POWER_NEXT_FRAME);
+    ws2812b_set_power_limit(&h, &power);
+    ws2812b_fill_buffer(&h, buf);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_full, buf, len);
+    TEST_ASSERT_EQUAL_UINT32(3050, power.requested_ma);
+    TEST_ASSERT_EQUAL_UINT32(3050, power.output_ma);
+    TEST_ASSERT_EQUAL_UINT32(81, power.scale);
+    TEST_ASSERT_EQUAL_UINT32(0, power.limited);
+
+    ws2812b_fill_buffer(&h, buf);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+    TEST_ASSERT_EQUAL_UINT32(3050, power.requested_ma);
+    TEST_ASSERT_EQUAL_UINT32(999, power.output_ma);
+
+    util_generate_iter_buf(&h, buf);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+    TEST_ASSERT_EQUAL_UINT32(3, power.frames);
+    TEST_ASSERT_EQUAL_UINT32(2, power.limited);
+
+    // Re-encode: Every frame is limited at once.
+    util_init_power(&power, WS2812B_POWER_REENCODE);
+    ws2812b_set_power_limit(&h, &power);
+    ws2812b_fill_buffer(&h, buf);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+    TEST_ASSERT_EQUAL_UINT32(999, power.output_ma);
+    TEST_ASSERT_EQUAL_UINT32(1, power.limited);
+
+    // Also if the LEDs are overwritten while encoding
+    uint8_t *inplace = malloc(len);
+    ws2812b_led_t *view = ws2812b_inplace_leds(&h, inplace);
+    memcpy(view, white, sizeof(white));
+    ws2812b_fill_buffer(&h, inplace);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, inplace, len);
+    h.leds = white;
+
+    // Random content: Re-encoding matches limiting in the next frame.
+    ws2812b_led_t leds[POWER_LED_COUNT];
+    util_random_leds(leds, POWER_LED_COUNT, 9);
+    h.leds = leds;
+    ws2812b_power_t next_power;
+    ws2812b_handle_t next;
+    util_init_handle(&next, leds, POWER_LED_COUNT, packings[p]);
+    util_init_power(&next_power, WS2812B_POWER_NEXT_FRAME);
+    next_power.budget_ma = 500;
+    power.budget_ma = 500;
+    ws2812b_set_power_limit(&next, &next_power);
+    ws2812b_fill_buffer(&next, expected);
+    ws2812b_fill_buffer(&next, expected);
+    ws2812b_fill_buffer(&h, buf);
+    TEST_ASSERT_TRUE(next_power.scale < 256);
+    TEST_ASSERT_EQUAL_UINT32(next_power.scale, power.scale);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+    TEST_ASSERT_TRUE(power.output_ma <= 500);
+
+    // Under budget, nothing is limited
+    power.budget_ma = 5000;
+    ws2812b_fill_buffer(&h, buf);
+    TEST_ASSERT_EQUAL_UINT32(256, power.scale);
+    TEST_ASSERT_EQUAL_UINT32(power.requested_ma, power.output_ma);
+
+    // The white channel of RGBW pixels is counted and limited as well.
+    // 50 * (1mA + 4 * 20mA) = 4050mA. Scale: (1000mA - 50mA) * 256 / 4000mA = 60.
+    uint8_t rgbw_full[4 * POWER_LED_COUNT];
+    uint8_t rgbw_limited[4 * POWER_LED_COUNT];
+    memset(rgbw_full, 0xFF, sizeof(rgbw_full));
+    memset(rgbw_limited, (255 * 60) >> 8, sizeof(rgbw_limited));
+    ws2812b_pixel_format_t format = WS2812B_PIXEL_FORMAT_RGBW;
+    ws2812b_handle_t rgbw_reference;
+    util_init_handle(&rgbw_reference, 0, POWER_LED_COUNT, packings[p]);
+    TEST_ASSERT_EQUAL_INT(0, ws2812b_set_source_pixels(&rgbw_reference, rgbw_limited, &format));
+    TEST_ASSERT_EQUAL_INT(0, ws2812b_set_source_pixels(&h, rgbw_full, &format));
+    uint32_t rgbw_len = ws2812b_required_buffer_len(&h);
+    uint8_t *rgbw_expected = malloc(rgbw_len);
+    uint8_t *rgbw_buf = malloc(rgbw_len);
+    ws2812b_fill_buffer(&rgbw_reference, rgbw_expected);
+
+    for (uint32_t m = 0; m < 2; m++) {
+      util_init_power(&power, m == 0 ? WS2812B_POWER_REENCODE : WS2812B_POWER_NEXT_FRAME);
+      ws2812b_set_power_limit(&h, &power);
+      ws2812b_fill_buffer(&h, rgbw_buf);
+      ws2812b_fill_buffer(&h, rgbw_buf);
+      TEST_ASSERT_EQUAL_UINT32(4050, power.requested_ma);
+      TEST_ASSERT_EQUAL_UINT32(60, power.scale);
+      TEST_ASSERT_TRUE(power.output_ma <= 1000);
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(rgbw_expected, rgbw_buf, rgbw_len);
+    }
+
+    free(rgbw_buf);
+    free(rgbw_expected);
+    free(inplace);
+    free(buf);
+    free(expected);
+    free(expected_full);
+  }
+}
+
+#define PALETTE_LED_COUNT 37
+void test_palette(void) {
+  ws2812b_led_t colors[256];
+  ws2812b_led_t leds[PALETTE_LED_COUNT];
+  ws2812b_led_t calibrated[PALETTE_LED_COUNT];
+  ws2812b_gain_t gains[PALETTE_LED_COUNT];
+  uint8_t indices[PALETTE_LED_COUNT];
+  uint8_t led_indices[PALETTE_LED_COUNT];
+  uint8_t encoded[WS2812B_PALETTE_ENCODED_LEN(256, WS2812B_PACKING_SINGLE)];
+  util_random_leds(colors, 256, 10);
+  util_random_leds((ws2812b_led_t *)gains, PALETTE_LED_COUNT, 11);
+
+  uint32_t bits[] = {4, 8};
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t b = 0; b < 2; b++) {
+    for (uint32_t p = 0; p < 2; p++) {
+      ws2812b_palette_t palette = {
+          .bits = bits[b],
+          .indices = indices,
+          .colors = colors,
+          .size = 1U << bits[b],
+          .encoded = encoded,
+      };
+
+      // Reference LEDs: 4-bit indices are packed two per byte, first LED in the high nibble.
+      srand(12);
+      for (uint32_t i = 0; i < PALETTE_LED_COUNT; i++) {
+        uint32_t index = rand() % palette.size;
+        if (bits[b] == 8) {
+          indices[i] = index;
+        } else if (i % 2 == 0) {
+          indices[i / 2] = index << 4;
+        } else {
+          indices[i / 2] |= index;
+        }
+        led_indices[i] = index;
+        leds[i] = colors[index];
+      }
+
+      ws2812b_handle_t h, reference;
+      util_init_handle(&reference, leds, PALETTE_LED_COUNT, packings[p]);
+      util_init_handle(&h, 0, PALETTE_LED_COUNT, packings[p]);
+      TEST_ASSERT_EQUAL_INT(0, ws2812b_set_source_palette(&h, &palette));
+      util_assert_same_output(&reference, &h);
+
+      // Changed entries are encoded again by ws2812b_update_palette.
+      colors[led_indices[0]] = (ws2812b_led_t){1, 2, 3};
+      for (uint32_t i = 0; i < PALETTE_LED_COUNT; i++) {
+        leds[i] = colors[led_indices[i]];
+      }
+      ws2812b_update_palette(&h);
+      util_assert_same_output(&reference, &h);
+
+      // Color curves are part of the encoded entries.
+      uint8_t curve[256];
+      ws2812b_generate_color_curve(curve, 2.2f, 255);
+      ws2812b_set_color_curve(&h, WS2812B_CHANNEL_GREEN, curve);
+      ws2812b_set_color_curve(&reference, WS2812B_CHANNEL_GREEN, curve);
+      ws2812b_update_palette(&h);
+      util_assert_same_output(&reference, &h);
+      ws2812b_set_color_curve(&h, WS2812B_CHANNEL_GREEN, 0);
+      ws2812b_update_palette(&h);
+
+      // Per-LED calibration is applied to palette colors while encoding.
+      for (uint32_t i = 0; i < PALETTE_LED_COUNT; i++) {
+        calibrated[i].red = (leds[i].red * (gains[i].red + 1)) >> 8;
+        calibrated[i].green = (leds[i].green * (gains[i].green + 1)) >> 8;
+        calibrated[i].blue = (leds[i].blue * (gains[i].blue + 1)) >> 8;
+      }
+      ws2812b_set_calibration(&h, gains);
+      util_init_handle(&reference, calibrated, PALETTE_LED_COUNT, packings[p]);
+      util_assert_same_output(&reference, &h);
+    }
+  }
+
+  // Invalid palettes
+  ws2812b_handle_t h;
+  util_init_handle(&h, 0, PALETTE_LED_COUNT, WS2812B_PACKING_SINGLE);
+  ws2812b_palette_t palette = {.bits = 4, .indices = indices, .colors = colors, .size = 17};
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_set_source_palette(&h, &palette));
+  palette.bits = 2;
+  palette.size = 4;
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_set_source_palette(&h, &palette));
+}
+
+#define COLOR_CACHE_LED_COUNT 100
+void test_color_cache(void) {
+  ws2812b_led_t leds[COLOR_CACHE_LED_COUNT];
+  ws2812b_color_cache_t cache;
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t p = 0; p < 2; p++) {
+    ws2812b_handle_t h, reference;
+    util_init_handle(&reference, leds, COLOR_CACHE_LED_COUNT, packings[p]);
+    util_init_handle(&h, leds, COLOR_CACHE_LED_COUNT, packings[p]);
+    ws2812b_set_color_cache(&h, &cache);
+
+    // Solid color: One LED is encoded, all others are copied from the previous one.
+    memset(leds, 0x42, sizeof(leds));
+    util_assert_same_output(&reference, &h);
+    TEST_ASSERT_EQUAL_UINT64(1, cache.misses);
+    TEST_ASSERT_EQUAL_UINT64(COLOR_CACHE_LED_COUNT - 1, cache.runs);
+    TEST_ASSERT_EQUAL_UINT64(0, cache.hits);
+
+    // Alternating colors: Repeats that are not adjacent are found in the cache.
+    ws2812b_set_color_cache(&h, &cache);
+    for (uint32_t i = 0; i < COLOR_CACHE_LED_COUNT; i++) {
+      leds[i] = i % 2 == 0 ? (ws2812b_led_t){255, 0, 0} : (ws2812b_led_t){0, 0, 255};
+    }
+    util_assert_same_output(&reference, &h);
+    TEST_ASSERT_EQUAL_UINT64(2, cache.misses);
+    TEST_ASSERT_EQUAL_UINT64(0, cache.runs);
+    TEST_ASSERT_EQUAL_UINT64(COLOR_CACHE_LED_COUNT - 2, cache.hits);
+
+    // Entries are kept between frames.
+    util_assert_same_output(&reference, &h);
+    TEST_ASSERT_EQUAL_UINT64(2, cache.misses);
+
+    // Random colors mostly miss, and still give the same output.
+    util_random_leds(leds, COLOR_CACHE_LED_COUNT, 13);
+    for (uint32_t i = 10; i < 20; i++) {
+      leds[i] = leds[9];
+    }
+    ws2812b_set_color_cache(&h, &cache);
+    util_assert_same_output(&reference, &h);
+    TEST_ASSERT_EQUAL_UINT64(10, cache.runs);
+    TEST_ASSERT_EQUAL_UINT64(COLOR_CACHE_LED_COUNT, cache.runs + cache.hits + cache.misses);
+
+    // The cache holds the output of color adjustments.
+    uint8_t curve[256];
+    ws2812b_generate_color_curve(curve, 2.2f, 200);
+    ws2812b_set_color_curve(&h, WS2812B_CHANNEL_RED, curve);
+    ws2812b_set_color_curve(&reference, WS2812B_CHANNEL_RED, curve);
+    util_assert_same_output(&reference, &h);
+  }
+}
+
+#define SOLID_LED_COUNT 41
+void test_fill_solid(void) {
+  ws2812b_led_t leds[SOLID_LED_COUNT];
+  ws2812b_led_t color = {12, 200, 77};
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t p = 0; p < 2; p++) {
+    ws2812b_handle_t h, reference;
+    util_init_handle(&reference, leds, SOLID_LED_COUNT, packings[p]);
+    util_init_handle(&h, leds, SOLID_LED_COUNT, packings[p]);
+    uint32_t len = ws2812b_required_buffer_len(&h);
+    uint8_t *expected = malloc(len);
+    uint8_t *buf = malloc(len);
+
+    // Whole strip
+    for (uint32_t i = 0; i < SOLID_LED_COUNT; i++) {
+      leds[i] = color;
+    }
+    ws2812b_fill_buffer(&reference, expected);
+    memset(buf, 0x55, len);
+    ws2812b_fill_solid(&h, buf, color, 0, SOLID_LED_COUNT);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+
+    // Part of the strip, other LEDs are kept. Ranges past the end are cut off.
+    util_random_leds(leds, SOLID_LED_COUNT, 14);
+    ws2812b_fill_buffer(&h, buf);
+    ws2812b_fill_solid(&h, buf, color, 3, 11);
+    ws2812b_fill_solid(&h, buf, color, SOLID_LED_COUNT - 2, 100);
+    ws2812b_fill_solid(&h, buf, color, SOLID_LED_COUNT + 1, 1);
+    for (uint32_t i = 3; i < 14; i++) {
+      leds[i] = color;
+    }
+    leds[SOLID_LED_COUNT - 2] = leds[SOLID_LED_COUNT - 1] = color;
+    ws2812b_fill_buffer(&reference, expected);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+
+    // Color curves are applied to the fill color, but not to blackout frames.
+    uint8_t curve[256];
+    ws2812b_generate_color_curve(curve, 1.0f, 128);
+    curve[0] = 5;
+    ws2812b_set_color_curve(&h, WS2812B_CHANNEL_BLUE, curve);
+    ws2812b_set_color_curve(&reference, WS2812B_CHANNEL_BLUE, curve);
+    for (uint32_t i = 0; i < SOLID_LED_COUNT; i++) {
+      leds[i] = color;
+    }
+    ws2812b_fill_buffer(&reference, expected);
+    ws2812b_fill_solid(&h, buf, color, 0, SOLID_LED_COUNT);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+
+    ws2812b_set_color_curve(&reference, WS2812B_CHANNEL_BLUE, 0);
+    memset(leds, 0, sizeof(leds));
+    ws2812b_fill_buffer(&reference, expected);
+    memset(buf, 0x55, len);
+    ws2812b_fill_blackout(&h, buf);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+
+    // Pre-built blackout frame
+    uint8_t *blackout = malloc(len);
+    ws2812b_set_blackout_frame(&h, blackout);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, blackout, len);
+    memset(buf, 0x55, len);
+    ws2812b_fill_blackout(&h, buf);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+
+    // Calibration and the power limit apply to solid fills like to any other frame.
+    ws2812b_led_t white = {255, 255, 255};
+    ws2812b_gain_t gains[SOLID_LED_COUNT];
+    for (uint32_t i = 0; i < SOLID_LED_COUNT; i++) {
+      leds[i] = white;
+      gains[i] = (ws2812b_gain_t){255 - i, 200 + i, 128};
+    }
+    ws2812b_power_t power, reference_power;
+    util_init_handle(&h, leds, SOLID_LED_COUNT, packings[p]);
+    util_init_handle(&reference, leds, SOLID_LED_COUNT, packings[p]);
+    util_init_power(&power, WS2812B_POWER_REENCODE);
+    util_init_power(&reference_power, WS2812B_POWER_REENCODE);
+    power.budget_ma = reference_power.budget_ma = 100;
+    ws2812b_set_power_limit(&h, &power);
+    ws2812b_set_power_limit(&reference, &reference_power);
+    for (uint32_t c = 0; c < 2; c++) {
+      ws2812b_fill_buffer(&reference, expected);
+      ws2812b_fill_solid(&h, buf, white, 0, SOLID_LED_COUNT);
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+      TEST_ASSERT_EQUAL_UINT32(reference_power.requested_ma, power.requested_ma);
+      TEST_ASSERT_EQUAL_UINT32(reference_power.output_ma, power.output_ma);
+      TEST_ASSERT_TRUE(power.output_ma <= 100);
+      TEST_ASSERT_EQUAL_UINT32(1, power.limited);
+
+      ws2812b_set_calibration(&h, gains);
+      ws2812b_set_calibration(&reference, gains);
+      power.limited = reference_power.limited = 0;
+    }
+
+    // Partial fills are limited with the scale of the last frame.
+    util_random_leds(leds, SOLID_LED_COUNT, 15);
+    ws2812b_fill_buffer(&h, buf);
+    ws2812b_fill_solid(&h, buf, white, 3, 11);
+    for (uint32_t i = 3; i < 14; i++) {
+      leds[i] = white;
+    }
+    reference_power.mode = WS2812B_POWER_NEXT_FRAME;
+    reference_power.scale = power.scale;
+    ws2812b_fill_buffer(&reference, expected);
+    uint32_t led_len = WS2812B_DATA_LEN(1, packings[p]);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&expected[1 + 3 * led_len], &buf[1 + 3 * led_len], 11 * led_len);
+
+    free(blackout);
+    free(buf);
+    free(expected);
+  }
+}
+
+#define MOVE_LED_COUNT 60
+// Applies the same operation to the reference LEDs and the buffer, and compares them.
+void util_assert_moved(ws2812b_handle_t *h, uint8_t *buf, ws2812b_led_t *expected) {
+  ws2812b_handle_t reference;
+  util_init_handle(&reference, expected, MOVE_LED_COUNT, h->config.packing);
+  uint32_t len = ws2812b_required_buffer_len(h);
+  uint8_t *expected_buf = malloc(len);
+  ws2812b_fill_buffer(&reference, expected_buf);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_buf, buf, len);
+  free(expected_buf);
+
+  // The LED array is updated when synced.
+  ws2812b_sync_leds(h, buf);
+  TEST_ASSERT_EQUAL_MEMORY(expected, h->leds, MOVE_LED_COUNT * sizeof(ws2812b_led_t));
+  TEST_ASSERT_EQUAL_UINT32(h->state.stale_first, h->state.stale_end);
+}
+
+void util_rotate_leds(ws2812b_led_t *leds, uint32_t first, uint32_t count, int32_t shift) {
+  ws2812b_led_t tmp[MOVE_LED_COUNT];
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t to = ((int32_t)i + shift % (int32_t)count + count) % count;
+    tmp[to] = leds[first + i];
+  }
+  memcpy(&leds[first], tmp, count * sizeof(ws2812b_led_t));
+}
+
+void test_move_leds(void) {
+  ws2812b_led_t leds[MOVE_LED_COUNT];
+  ws2812b_led_t expected[MOVE_LED_COUNT];
+  ws2812b_led_t fill = {1, 2, 3};
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t p = 0; p < 2; p++) {
+    ws2812b_handle_t h;
+    util_init_handle(&h, leds, MOVE_LED_COUNT, packings[p]);
+    uint8_t *buf = malloc(ws2812b_required_buffer_len(&h));
+    util_random_leds(leds, MOVE_LED_COUNT, 15);
+    memcpy(expected, leds, sizeof(leds));
+    ws2812b_fill_buffer(&h, buf);
+
+    // Rotate by few LEDs (set aside) and by many (reversals), in both directions.
+    int32_t shifts[] = {3, -5, 25, -24, 47, 0, 100};
+    for (uint32_t s = 0; s < sizeof(shifts) / sizeof(shifts[0]); s++) {
+      ws2812b_rotate_leds(&h, buf, 4, 50, shifts[s]);
+      util_rotate_leds(expected, 4, 50, shifts[s]);
+      util_assert_moved(&h, buf, expected);
+    }
+
+    // Whole strip, and ranges past the end are cut off.
+    ws2812b_rotate_leds(&h, buf, 0, 1000, -1);
+    util_rotate_leds(expected, 0, MOVE_LED_COUNT, -1);
+    util_assert_moved(&h, buf, expected);
+    ws2812b_rotate_leds(&h, buf, 50, 20, 4);
+    util_rotate_leds(expected, 50, 10, 4);
+    util_assert_moved(&h, buf, expected);
+
+    // Scroll
+    ws2812b_scroll_leds(&h, buf, 10, 20, 3, fill);
+    memmove(&expected[13], &expected[10], 17 * sizeof(ws2812b_led_t));
+    expected[10] = expected[11] = expected[12] = fill;
+    util_assert_moved(&h, buf, expected);
+
+    ws2812b_scroll_leds(&h, buf, 10, 20, -18, fill);
+    memmove(&expected[10], &expected[28], 2 * sizeof(ws2812b_led_t));
+    for (uint32_t i = 12; i < 30; i++) {
+      expected[i] = fill;
+    }
+    util_assert_moved(&h, buf, expected);
+
+    ws2812b_scroll_leds(&h, buf, 0, 5, 5, fill);
+    for (uint32_t i = 0; i < 5; i++) {
+      expected[i] = fill;
+    }
+    util_assert_moved(&h, buf, expected);
+
+    // Mirror
+    ws2812b_mirror_leds(&h, buf, 7, 13);
+    for (uint32_t i = 0; i < 6; i++) {
+      ws2812b_led_t tmp = expected[7 + i];
+      expected[7 + i] = expected[19 - i];
+      expected[19 - i] = tmp;
+    }
+    util_assert_moved(&h, buf, expected);
+
+    // Copy, with overlapping ranges
+    ws2812b_copy_leds(&h, buf, 35, 30, 20);
+    memmove(&expected[35], &expected[30], 20 * sizeof(ws2812b_led_t));
+    util_assert_moved(&h, buf, expected);
+    ws2812b_copy_leds(&h, buf, 0, 2, 10);
+    memmove(&expected[0], &expected[2], 10 * sizeof(ws2812b_led_t));
+    util_assert_moved(&h, buf, expected);
+
+    // Sync after several operations. The LED array is not changed until then.
+    ws2812b_rotate_leds(&h, buf, 0, 10, 1);
+    util_rotate_leds(expected, 0, 10, 1);
+    ws2812b_mirror_leds(&h, buf, 40, 20);
+    for (uint32_t i = 0; i < 10; i++) {
+      ws2812b_led_t tmp = expected[40 + i];
+      expected[40 + i] = expected[59 - i];
+      expected[59 - i] = tmp;
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, h.state.stale_first);
+    TEST_ASSERT_EQUAL_UINT32(MOVE_LED_COUNT, h.state.stale_end);
+    TEST_ASSERT_FALSE(memcmp(expected, leds, sizeof(leds)) == 0);
+    ws2812b_sync_leds(&h, buf);
+    TEST_ASSERT_EQUAL_MEMORY(expected, leds, sizeof(leds));
+
+    free(buf);
+  }
+}
+
+#define RETARGET_LED_COUNT 45
+void test_retarget(void) {
+  ws2812b_led_t leds[RETARGET_LED_COUNT];
+  util_random_leds(leds, RETARGET_LED_COUNT, 16);
+
+  ws2812b_pulse_len_t pulses_0[] = {WS2812B_PULSE_LEN_1b, WS2812B_PULSE_LEN_1b,
+                                     WS2812B_PULSE_LEN_2b};
+  ws2812b_pulse_len_t pulses_1[] = {WS2812B_PULSE_LEN_3b, WS2812B_PULSE_LEN_2b,
+                                     WS2812B_PULSE_LEN_3b};
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+
+  for (uint32_t p = 0; p < 2; p++) {
+    ws2812b_handle_t h, reference;
+    util_init_handle(&h, leds, RETARGET_LED_COUNT, packings[p]);
+    util_init_handle(&reference, leds, RETARGET_LED_COUNT, packings[p]);
+    uint32_t len = ws2812b_required_buffer_len(&h);
+    uint8_t *expected = malloc(len);
+    uint8_t *buf = malloc(len);
+    uint8_t *blackout = malloc(len);
+    ws2812b_color_cache_t cache;
+    ws2812b_set_color_cache(&h, &cache);
+    ws2812b_set_blackout_frame(&h, blackout);
+    ws2812b_fill_buffer(&h, buf);
+
+    // Every combination of pulse lengths, bit order and first bit 0, one after the other.
+    for (uint32_t i = 0; i < 12; i++) {
+      ws2812b_config_t config = h.config;
+      config.pulse_len_0 = pulses_0[i % 3];
+      config.pulse_len_1 = pulses_1[i % 3];
+      config.spi_bit_order = (i / 3) % 2 ? WS2812B_LSB_FIRST : WS2812B_MSB_FIRST;
+      config.first_bit_0 = (i / 6) % 2 ? WS2812B_FIRST_BIT_0_DISABLED : WS2812B_FIRST_BIT_0_ENABLED;
+      TEST_ASSERT_EQUAL_INT(0, ws2812b_retarget(&h, &config, buf));
+
+      reference.config = config;
+      TEST_ASSERT_FALSE(ws2812b_init(&reference));
+      ws2812b_fill_buffer(&reference, expected);
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+
+      // Cached encodings are retargeted as well.
+      cache.hits = 0;
+      util_assert_same_output(&reference, &h);
+      TEST_ASSERT_TRUE(cache.hits > 0);
+
+      memset(leds, 0, sizeof(leds));
+      ws2812b_fill_buffer(&reference, expected);
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, blackout, len);
+      util_random_leds(leds, RETARGET_LED_COUNT, 16);
+    }
+
+    // The buffer layout can not change.
+    ws2812b_config_t config = h.config;
+    config.packing = packings[1 - p];
+    TEST_ASSERT_EQUAL_INT(-1, ws2812b_retarget(&h, &config, buf));
+    config = h.config;
+    config.prefix_len++;
+    TEST_ASSERT_EQUAL_INT(-1, ws2812b_retarget(&h, &config, buf));
+
+    // Invalid configs are rejected, and the old config is kept.
+    config = h.config;
+    config.pulse_len_0 = WS2812B_PULSE_LEN_3b;
+    TEST_ASSERT_EQUAL_INT(-1, ws2812b_retarget(&h, &config, buf));
+    TEST_ASSERT_EQUAL_INT(reference.config.pulse_len_0, h.config.pulse_len_0);
+    util_assert_same_output(&reference, &h);
+
+    // Cache entries hold 3-channel colors, and are retargeted within their bounds while an RGBW
+    // source is set.
+    uint8_t rgb[3 * RETARGET_LED_COUNT];
+    uint8_t rgbw[4 * RETARGET_LED_COUNT];
+    for (uint32_t i = 0; i < RETARGET_LED_COUNT; i++) {
+      rgb[3 * i + 0] = rgbw[4 * i + 0] = leds[i].red;
+      rgb[3 * i + 1] = rgbw[4 * i + 1] = leds[i].green;
+      rgb[3 * i + 2] = rgbw[4 * i + 2] = leds[i].blue;
+      rgbw[4 * i + 3] = i;
+    }
+    ws2812b_pixel_format_t format_rgb = WS2812B_PIXEL_FORMAT_RGB;
+    ws2812b_pixel_format_t format_rgbw = WS2812B_PIXEL_FORMAT_RGBW;
+    ws2812b_color_cache_t cached = cache;
+    ws2812b_set_blackout_frame(&h, 0); // Sized for 3 channels.
+    TEST_ASSERT_EQUAL_INT(0, ws2812b_set_source_pixels(&h, rgbw, &format_rgbw));
+    config = h.config;
+    config.pulse_len_0 = pulses_0[1];
+    config.pulse_len_1 = pulses_1[1];
+    TEST_ASSERT_EQUAL_INT(0, ws2812b_retarget(&h, &config, 0));
+    for (uint32_t i = 0; i < WS2812B_COLOR_CACHE_LEN; i++) {
+      TEST_ASSERT_EQUAL_HEX32(cached.entries[i].color, cache.entries[i].color);
+    }
+    TEST_ASSERT_EQUAL_HEX32(cached.last_color, cache.last_color);
+    TEST_ASSERT_EQUAL_UINT32(cached.last_entry, cache.last_entry);
+
+    // The retargeted entries are used again with a 3-channel source.
+    TEST_ASSERT_EQUAL_INT(0, ws2812b_set_source_pixels(&h, rgb, &format_rgb));
+    reference.config = config;
+    TEST_ASSERT_FALSE(ws2812b_init(&reference));
+    cache.hits = 0;
+    util_assert_same_output(&reference, &h);
+    TEST_ASSERT_TRUE(cache.hits > 0);
+
+    free(blackout);
+    free(buf);
+    free(expected);
+  }
+
+  // Palette entries
+  ws2812b_led_t colors[16];
+  uint8_t indices[RETARGET_LED_COUNT];
+  uint8_t encoded[WS2812B_PALETTE_ENCODED_LEN(16, WS2812B_PACKING_SINGLE)];
+  util_random_leds(colors, 16, 17);
+  for (uint32_t i = 0; i < RETARGET_LED_COUNT; i++) {
+    indices[i] = i % 16;
+    leds[i] = colors[i % 16];
+  }
+  ws2812b_palette_t palette = {8, indices, colors, 16, encoded};
+
+  ws2812b_handle_t h, reference;
+  util_init_handle(&h, 0, RETARGET_LED_COUNT, WS2812B_PACKING_SINGLE);
+  util_init_handle(&reference, leds, RETARGET_LED_COUNT, WS2812B_PACKING_SINGLE);
+  ws2812b_set_source_palette(&h, &palette);
+  reference.config.spi_bit_order = WS2812B_LSB_FIRST;
+  TEST_ASSERT_FALSE(ws2812b_init(&reference));
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_retarget(&h, &reference.config, 0));
+  util_assert_same_output(&reference, &h);
+}
+
+#define PIXEL_LED_COUNT 45
+// Reference LEDs that send the same bytes as a sequence of wire-ordered channel values.
+void util_wire_leds(const uint8_t *wire, uint32_t len, ws2812b_led_t *leds) {
+  for (uint32_t i = 0; i < len / 3; i++) {
+    leds[i].green = wire[3 * i + 0];
+    leds[i].red = wire[3 * i + 1];
+    leds[i].blue = wire[3 * i + 2];
+  }
+}
+
+void test_pixel_format(void) {
+  ws2812b_led_t leds[PIXEL_LED_COUNT * 4 / 3];
+  ws2812b_led_t colors[PIXEL_LED_COUNT];
+  uint8_t pixels[PIXEL_LED_COUNT * 5];
+  uint8_t wire[PIXEL_LED_COUNT * 4];
+  util_random_leds(colors, PIXEL_LED_COUNT, 18);
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t p = 0; p < 2; p++) {
+    ws2812b_handle_t h, reference;
+
+    // BGR input
+    ws2812b_pixel_format_t bgr = WS2812B_PIXEL_FORMAT_BGR;
+    for (uint32_t i = 0; i < PIXEL_LED_COUNT; i++) {
+      pixels[3 * i + 0] = colors[i].blue;
+      pixels[3 * i + 1] = colors[i].green;
+      pixels[3 * i + 2] = colors[i].red;
+    }
+    util_init_handle(&h, 0, PIXEL_LED_COUNT, packings[p]);
+    util_init_handle(&reference, colors, PIXEL_LED_COUNT, packings[p]);
+    TEST_ASSERT_EQUAL_INT(0, ws2812b_set_source_pixels(&h, pixels, &bgr));
+    util_assert_same_output(&reference, &h);
+
+    // Color adjustments apply as usual.
+    uint8_t curve[256];
+    ws2812b_generate_color_curve(curve, 2.2f, 200);
+    ws2812b_set_color_curve(&h, WS2812B_CHANNEL_RED, curve);
+    ws2812b_set_color_curve(&reference, WS2812B_CHANNEL_RED, curve);
+    util_assert_same_output(&reference, &h);
+
+    // LEDs wired in R, G, B order
+    ws2812b_pixel_format_t rgb_wired = {
+        3, 3, {0, 1, 2, 0}, {WS2812B_CHANNEL_RED, WS2812B_CHANNEL_GREEN, WS2812B_CHANNEL_BLUE, 0}};
+    for (uint32_t i = 0; i < PIXEL_LED_COUNT; i++) {
+      pixels[3 * i + 0] = wire[3 * i + 0] = colors[i].red;
+      pixels[3 * i + 1] = wire[3 * i + 1] = colors[i].green;
+      pixels[3 * i + 2] = wire[3 * i + 2] = colors[i].blue;
+    }
+    util_wire_leds(wire, PIXEL_LED_COUNT * 3, leds);
+    util_init_handle(&h, 0, PIXEL_LED_COUNT, packings[p]);
+    util_init_handle(&reference, leds, PIXEL_LED_COUNT, packings[p]);
+    TEST_ASSERT_EQUAL_INT(0, ws2812b_set_source_pixels(&h, pixels, &rgb_wired));
+    util_assert_same_output(&reference, &h);
+
+    // RGBW with a padding byte: 4 channels of every LED are sent as 4/3 reference LEDs. The
+    // color cache only holds 3-channel LEDs, and is not used.
+    ws2812b_pixel_format_t rgbw = {
+        4,
+        5,
+        {4, 2, 1, 3},
+        {WS2812B_CHANNEL_GREEN, WS2812B_CHANNEL_RED, WS2812B_CHANNEL_BLUE, WS2812B_CHANNEL_WHITE}};
+    for (uint32_t i = 0; i < PIXEL_LED_COUNT; i++) {
+      uint8_t white = rand();
+      pixels[5 * i + 0] = 0xAA;
+      pixels[5 * i + 4] = wire[4 * i + 1] = colors[i].red;
+      pixels[5 * i + 2] = wire[4 * i + 0] = colors[i].green;
+      pixels[5 * i + 1] = wire[4 * i + 2] = colors[i].blue;
+      pixels[5 * i + 3] = wire[4 * i + 3] = white;
+    }
+    util_wire_leds(wire, PIXEL_LED_COUNT * 4, leds);
+    util_init_handle(&h, 0, PIXEL_LED_COUNT, packings[p]);
+    util_init_handle(&reference, leds, PIXEL_LED_COUNT * 4 / 3, packings[p]);
+    TEST_ASSERT_EQUAL_INT(0, ws2812b_set_source_pixels(&h, pixels, &rgbw));
+    TEST_ASSERT_EQUAL_UINT32(WS2812B_PIXEL_BUFFER_LEN(PIXEL_LED_COUNT, 4, packings[p], 1, 4),
+                             ws2812b_required_buffer_len(&h));
+    util_assert_same_output(&reference, &h);
+
+    ws2812b_color_cache_t cache;
+    ws2812b_set_color_cache(&h, &cache);
+    util_assert_same_output(&reference, &h);
+    TEST_ASSERT_EQUAL_UINT64(0, cache.runs + cache.hits + cache.misses);
+
+    // Solid fills turn white off.
+    uint32_t len = ws2812b_required_buffer_len(&h);
+    uint8_t *expected = malloc(len);
+    uint8_t *buf = malloc(len);
+    for (uint32_t i = 0; i < PIXEL_LED_COUNT; i++) {
+      wire[4 * i + 0] = colors[0].green;
+      wire[4 * i + 1] = colors[0].red;
+      wire[4 * i + 2] = colors[0].blue;
+      wire[4 * i + 3] = 0;
+    }
+    util_wire_leds(wire, PIXEL_LED_COUNT * 4, leds);
+    ws2812b_fill_buffer(&reference, expected);
+    ws2812b_fill_solid(&h, buf, colors[0], 0, PIXEL_LED_COUNT);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+
+    memset(leds, 0, sizeof(leds));
+    ws2812b_fill_buffer(&reference, expected);
+    ws2812b_fill_blackout(&h, buf);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, len);
+
+    free(buf);
+    free(expected);
+  }
+
+  // Invalid formats are rejected.
+  ws2812b_handle_t h;
+  util_init_handle(&h, colors, PIXEL_LED_COUNT, WS2812B_PACKING_SINGLE);
+  ws2812b_pixel_format_t format = WS2812B_PIXEL_FORMAT_RGBW;
+  format.channels = 5;
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_set_source_pixels(&h, pixels, &format));
+  format = (ws2812b_pixel_format_t)WS2812B_PIXEL_FORMAT_RGBW;
+  format.order[3] = WS2812B_CHANNEL_RED;
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_set_source_pixels(&h, pixels, &format));
+  format = (ws2812b_pixel_format_t)WS2812B_PIXEL_FORMAT_RGB;
+  format.order[2] = WS2812B_CHANNEL_WHITE;
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_set_source_pixels(&h, pixels, &format));
+  format = (ws2812b_pixel_format_t)WS2812B_PIXEL_FORMAT_RGB;
+  format.offsets[WS2812B_CHANNEL_BLUE] = 3;
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_set_source_pixels(&h, pixels, &format));
+  TEST_ASSERT_EQUAL_INT(WS2812B_SOURCE_LEDS, h.state.source);
+}
+
+#define PLANAR_LED_COUNT 45
+void test_planar_source(void) {
+  ws2812b_led_t leds[PLANAR_LED_COUNT];
+  util_random_leds(leds, PLANAR_LED_COUNT, 19);
+
+  // malloc returns memory aligned for any type, which covers WS2812B_PLANE_ALIGN on x86-64.
+  uint8_t *red = malloc(PLANAR_LED_COUNT);
+  uint8_t *green = malloc(PLANAR_LED_COUNT);
+  uint8_t *blue = malloc(PLANAR_LED_COUNT);
+  for (uint32_t i = 0; i < PLANAR_LED_COUNT; i++) {
+    red[i] = leds[i].red;
+    green[i] = leds[i].green;
+    blue[i] = leds[i].blue;
+  }
+  ws2812b_planar_t planes = {red, green, blue};
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  ws2812b_order_t orders[] = {WS2812B_MSB_FIRST, WS2812B_LSB_FIRST};
+  for (uint32_t p = 0; p < 4; p++) {
+    ws2812b_handle_t h, reference;
+    util_init_handle(&h, 0, PLANAR_LED_COUNT, packings[p % 2]);
+    util_init_handle(&reference, leds, PLANAR_LED_COUNT, packings[p % 2]);
+    h.config.spi_bit_order = reference.config.spi_bit_order = orders[p / 2];
+    TEST_ASSERT_FALSE(ws2812b_init(&h));
+    TEST_ASSERT_FALSE(ws2812b_init(&reference));
+    TEST_ASSERT_EQUAL_INT(0, ws2812b_set_source_planar(&h, &planes));
+    util_assert_same_output(&reference, &h);
+
+    // Color curves are applied by the planar encoder.
+    uint8_t curve[256];
+    ws2812b_generate_color_curve(curve, 2.2f, 200);
+    ws2812b_set_color_curve(&h, WS2812B_CHANNEL_GREEN, curve);
+    ws2812b_set_color_curve(&reference, WS2812B_CHANNEL_GREEN, curve);
+    util_assert_same_output(&reference, &h);
+
+    // Other adjustments interleave the planes first.
+    ws2812b_color_matrix_t matrix = {{{3900, 200, 0}, {0, 4096, 0}, {100, -50, 4000}}};
+    ws2812b_set_color_matrix(&h, &matrix);
+    ws2812b_set_color_matrix(&reference, &matrix);
+    util_assert_same_output(&reference, &h);
+  }
+
+  // Misaligned planes are rejected.
+  ws2812b_handle_t h;
+  util_init_handle(&h, leds, PLANAR_LED_COUNT - 1, WS2812B_PACKING_SINGLE);
+  planes.blue = blue + 1;
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_set_source_planar(&h, &planes));
+  TEST_ASSERT_EQUAL_INT(WS2812B_SOURCE_LEDS, h.state.source);
+
+  free(blue);
+  free(green);
+  free(red);
+}
+
+#define COMPRESSED_LED_COUNT 45
+void test_compressed_source(void) {
+  ws2812b_led_t leds[COMPRESSED_LED_COUNT];
+  ws2812b_led_t expanded_565[COMPRESSED_LED_COUNT];
+  ws2812b_led_t expanded_444[COMPRESSED_LED_COUNT];
+  uint16_t leds_565[COMPRESSED_LED_COUNT];
+  uint8_t leds_444[WS2812B_RGB444_LEN(COMPRESSED_LED_COUNT)];
+  util_random_leds(leds, COMPRESSED_LED_COUNT, 20);
+
+  // Expected colors: The high bits are repeated in the low ones.
+  for (uint32_t i = 0; i < COMPRESSED_LED_COUNT; i++) {
+    leds_565[i] = WS2812B_RGB565(leds[i].red, leds[i].green, leds[i].blue);
+    expanded_565[i].red = (leds[i].red & 0xF8) | leds[i].red >> 5;
+    expanded_565[i].green = (leds[i].green & 0xFC) | leds[i].green >> 6;
+    expanded_565[i].blue = (leds[i].blue & 0xF8) | leds[i].blue >> 5;
+
+    ws2812b_set_rgb444(leds_444, i, leds[i]);
+    expanded_444[i].red = (leds[i].red >> 4) * 17;
+    expanded_444[i].green = (leds[i].green >> 4) * 17;
+    expanded_444[i].blue = (leds[i].blue >> 4) * 17;
+  }
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t p = 0; p < 4; p++) {
+    // Built-in tables, and caller's tables which the curves are merged into.
+    ws2812b_expand_tables_t tables_565, tables_444;
+    ws2812b_handle_t h_565, h_444, reference_565, reference_444;
+    util_init_handle(&h_565, 0, COMPRESSED_LED_COUNT, packings[p % 2]);
+    util_init_handle(&h_444, 0, COMPRESSED_LED_COUNT, packings[p % 2]);
+    util_init_handle(&reference_565, expanded_565, COMPRESSED_LED_COUNT, packings[p % 2]);
+    util_init_handle(&reference_444, expanded_444, COMPRESSED_LED_COUNT, packings[p % 2]);
+    ws2812b_set_source_rgb565(&h_565, leds_565, p < 2 ? 0 : &tables_565);
+    ws2812b_set_source_rgb444(&h_444, leds_444, p < 2 ? 0 : &tables_444);
+    util_assert_same_output(&reference_565, &h_565);
+    util_assert_same_output(&reference_444, &h_444);
+
+    uint8_t curve[256];
+    ws2812b_generate_color_curve(curve, 2.2f, 200);
+    ws2812b_handle_t *handles[] = {&h_565, &h_444, &reference_565, &reference_444};
+    for (uint32_t i = 0; i < 4; i++) {
+      ws2812b_set_color_curve(handles[i], WS2812B_CHANNEL_BLUE, curve);
+    }
+    util_assert_same_output(&reference_565, &h_565);
+    util_assert_same_output(&reference_444, &h_444);
+    if (p >= 2) {
+      TEST_ASSERT_EQUAL_UINT8(curve[255], tables_565.blue[31]);
+      TEST_ASSERT_EQUAL_UINT8(curve[255], tables_444.blue[15]);
+      TEST_ASSERT_EQUAL_UINT8(255, tables_444.red[15]);
+    }
+
+    // Curves changed in place are merged again on request.
+    ws2812b_generate_color_curve(curve, 2.2f, 64);
+    ws2812b_update_expand_tables(&h_565);
+    ws2812b_update_expand_tables(&h_444);
+    util_assert_same_output(&reference_565, &h_565);
+    util_assert_same_output(&reference_444, &h_444);
+
+    // With the color matrix in between, expansion and curves are applied separately again.
+    ws2812b_color_matrix_t matrix = {{{3900, 200, 0}, {0, 4096, 0}, {100, -50, 4000}}};
+    for (uint32_t i = 0; i < 4; i++) {
+      ws2812b_set_color_matrix(handles[i], &matrix);
+    }
+    util_assert_same_output(&reference_565, &h_565);
+    util_assert_same_output(&reference_444, &h_444);
+  }
+}
+
+#define SHADER_LED_COUNT 45
+ws2812b_led_t util_shader_color(uint32_t index, void *ctx) {
+  uint32_t frame = *(uint32_t *)ctx;
+  return (ws2812b_led_t){index * 5 + frame, 255 - index, (index ^ 0x55) + frame};
+}
+
+void util_shader_colors(uint32_t first, uint32_t count, ws2812b_led_t *leds, void *ctx) {
+  TEST_ASSERT_TRUE(count >= 1 && count <= WS2812B_SHADER_BATCH_LEN);
+  TEST_ASSERT_TRUE(first + count <= SHADER_LED_COUNT);
+  for (uint32_t i = 0; i < count; i++) {
+    leds[i] = util_shader_color(first + i, ctx);
+  }
+}
+
+void test_shader_source(void) {
+  ws2812b_led_t leds[SHADER_LED_COUNT];
+  uint32_t frame = 0;
+  ws2812b_shader_t single = {util_shader_color, 0, &frame};
+  ws2812b_shader_t batched = {0, util_shader_colors, &frame};
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t p = 0; p < 2; p++) {
+    ws2812b_handle_t h_single, h_batched, reference;
+    util_init_handle(&h_single, 0, SHADER_LED_COUNT, packings[p]);
+    util_init_handle(&h_batched, 0, SHADER_LED_COUNT, packings[p]);
+    util_init_handle(&reference, leds, SHADER_LED_COUNT, packings[p]);
+    TEST_ASSERT_EQUAL_INT(0, ws2812b_set_source_shader(&h_single, &single));
+    TEST_ASSERT_EQUAL_INT(0, ws2812b_set_source_shader(&h_batched, &batched));
+
+    // Colors are computed anew for every frame.
+    for (frame = 0; frame < 3; frame++) {
+      for (uint32_t i = 0; i < SHADER_LED_COUNT; i++) {
+        leds[i] = util_shader_color(i, &frame);
+      }
+      util_assert_same_output(&reference, &h_single);
+      util_assert_same_output(&reference, &h_batched);
+    }
+  }
+
+  // A shader needs at least one function.
+  ws2812b_handle_t h;
+  ws2812b_shader_t empty = {0, 0, 0};
+  util_init_handle(&h, leds, SHADER_LED_COUNT, WS2812B_PACKING_SINGLE);
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_set_source_shader(&h, &empty));
+  TEST_ASSERT_EQUAL_INT(WS2812B_SOURCE_LEDS, h.state.source);
+}
+
+#define LAYOUT_LED_COUNT 48
+// Framebuffer index of every LED in chain order, worked out LED by LED.
+void util_layout_map(const ws2812b_layout_t *l, uint32_t *map) {
+  uint32_t width = l->tile_width * l->tiles_x;
+  uint32_t led = 0;
+  for (uint32_t tile_row = 0; tile_row < l->tiles_y; tile_row++) {
+    for (uint32_t t = 0; t < l->tiles_x; t++) {
+      bool tiles_reversed = (l->flags & WS2812B_LAYOUT_TILES_SERPENTINE) && tile_row % 2;
+      uint32_t tile_col = tiles_reversed ? l->tiles_x - 1 - t : t;
+      bool columns = l->flags & WS2812B_LAYOUT_COLUMNS;
+      uint32_t lines = columns ? l->tile_width : l->tile_height;
+      uint32_t line_len = columns ? l->tile_height : l->tile_width;
+      for (uint32_t line = 0; line < lines; line++) {
+        for (uint32_t pos = 0; pos < line_len; pos++) {
+          bool reversed = (l->flags & WS2812B_LAYOUT_SERPENTINE) && line % 2;
+          uint32_t along = reversed ? line_len - 1 - pos : pos;
+          uint32_t x = tile_col * l->tile_width + (columns ? line : along);
+          uint32_t y = tile_row * l->tile_height + (columns ? along : line);
+          map[led++] = y * width + x;
+        }
+      }
+    }
+  }
+}
+
+void test_layout(void) {
+  ws2812b_led_t leds[LAYOUT_LED_COUNT];
+  ws2812b_led_t wired[LAYOUT_LED_COUNT];
+  uint32_t map[LAYOUT_LED_COUNT];
+  util_random_leds(leds, LAYOUT_LED_COUNT, 21);
+
+  // Random permutation as a mapping table
+  uint32_t table[LAYOUT_LED_COUNT];
+  for (uint32_t i = 0; i < LAYOUT_LED_COUNT; i++) {
+    table[i] = i;
+  }
+  srand(22);
+  for (uint32_t i = LAYOUT_LED_COUNT - 1; i > 0; i--) {
+    uint32_t j = rand() % (i + 1);
+    uint32_t tmp = table[i];
+    table[i] = table[j];
+    table[j] = tmp;
+  }
+
+  ws2812b_layout_t layouts[] = {
+      {0, 8, 6, 1, 1, WS2812B_LAYOUT_SERPENTINE},
+      {0, 4, 3, 2, 2, 0},
+      {0, 4, 3, 2, 2, WS2812B_LAYOUT_COLUMNS | WS2812B_LAYOUT_SERPENTINE},
+      {0, 4, 3, 2, 2,
+       WS2812B_LAYOUT_COLUMNS | WS2812B_LAYOUT_SERPENTINE | WS2812B_LAYOUT_TILES_SERPENTINE},
+      {0, 2, 2, 4, 3, WS2812B_LAYOUT_SERPENTINE | WS2812B_LAYOUT_TILES_SERPENTINE},
+      {table, 0, 0, 0, 0, 0},
+  };
+
+  ws2812b_packing_t packings[] = {WS2812B_PACKING_SINGLE, WS2812B_PACKING_DOUBLE};
+  for (uint32_t p = 0; p < 2; p++) {
+    for (uint32_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+      if (layouts[l].table != 0) {
+        memcpy(map, table, sizeof(map));
+      } else {
+        util_layout_map(&layouts[l], map);
+      }
+      for (uint32_t i = 0; i < LAYOUT_LED_COUNT; i++) {
+        wired[i] = leds[map[i]];
+      }
+
+      ws2812b_handle_t h, reference;
+      util_init_handle(&h, leds, LAYOUT_LED_COUNT, packings[p]);
+      util_init_handle(&reference, wired, LAYOUT_LED_COUNT, packings[p]);
+      TEST_ASSERT_EQUAL_INT(0, ws2812b_set_layout(&h, &layouts[l]));
+      util_assert_same_output(&reference, &h);
+
+      // Moved LEDs are synced back to their place in the framebuffer.
+      ws2812b_led_t framebuffer[LAYOUT_LED_COUNT];
+      memcpy(framebuffer, leds, sizeof(leds));
+      h.leds = framebuffer;
+      uint8_t *buf = malloc(ws2812b_required_buffer_len(&h));
+      ws2812b_fill_buffer(&h, buf);
+      ws2812b_rotate_leds(&h, buf, 0, LAYOUT_LED_COUNT, 1);
+      ws2812b_sync_leds(&h, buf);
+      for (uint32_t i = 0; i < LAYOUT_LED_COUNT; i++) {
+        ws2812b_led_t expected = leds[map[i]];
+        TEST_ASSERT_EQUAL_MEMORY(&expected, &framebuffer[map[(i + 1) % LAYOUT_LED_COUNT]],
+                                 sizeof(ws2812b_led_t));
+      }
+      free(buf);
+    }
+  }
+
+  // Rules have to cover exactly every LED.
+  ws2812b_handle_t h;
+  util_init_handle(&h, leds, LAYOUT_LED_COUNT, WS2812B_PACKING_SINGLE);
+  ws2812b_layout_t too_small = {0, 4, 3, 2, 1, 0};
+  ws2812b_layout_t empty = {0, 0, 3, 2, 2, 0};
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_set_layout(&h, &too_small));
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_set_layout(&h, &empty));
+  TEST_ASSERT_NULL(h.state.layout);
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_set_layout(&h, 0));
+}
+
 // ======== Main ===================================================================================
 
 void setUp(void) {}
@@ -643,5 +2515,27 @@ int main(void) {
   RUN_TEST(test_pulse_length);
   RUN_TEST(test_first_bit_0);
   RUN_TEST(test_spi_bit_order);
+  RUN_TEST(test_segments);
+  RUN_TEST(test_chain);
+  RUN_TEST(test_inplace);
+  RUN_TEST(test_large_buffer);
+  RUN_TEST(test_clean_hook);
+  RUN_TEST(test_color_curves);
+  RUN_TEST(test_led16_dithering);
+  RUN_TEST(test_float_source);
+  RUN_TEST(test_hsv_source);
+  RUN_TEST(test_color_matrix);
+  RUN_TEST(test_calibration);
+  RUN_TEST(test_power_limit);
+  RUN_TEST(test_palette);
+  RUN_TEST(test_color_cache);
+  RUN_TEST(test_fill_solid);
+  RUN_TEST(test_move_leds);
+  RUN_TEST(test_retarget);
+  RUN_TEST(test_pixel_format);
+  RUN_TEST(test_planar_source);
+  RUN_TEST(test_compressed_source);
+  RUN_TEST(test_shader_source);
+  RUN_TEST(test_layout);
   return UNITY_END();
 }
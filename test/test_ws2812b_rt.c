@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "ws2812b_rt.h"
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+#define PERIOD_NS 1000000
+#define FRAME_COUNT 20
+
+// ======== Utils ==================================================================================
+
+typedef struct {
+  uint64_t times[FRAME_COUNT];
+  uint64_t stall_frame;
+  uint64_t stall_ns;
+  bool done;
+} frame_log_t;
+
+uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+int log_frame(void *ctx, uint64_t frame_index) {
+  frame_log_t *log = ctx;
+  log->times[frame_index] = now_ns();
+
+  if (frame_index == log->stall_frame) {
+    struct timespec ts = {0, log->stall_ns};
+    nanosleep(&ts, NULL);
+  }
+
+  if (frame_index == FRAME_COUNT - 1) {
+    __atomic_store_n(&log->done, true, __ATOMIC_RELEASE);
+    return 1;
+  }
+  return 0;
+}
+
+void util_run(ws2812b_rt_t *rt, frame_log_t *log) {
+  TEST_ASSERT_EQUAL(0, ws2812b_rt_start(rt));
+  while (!__atomic_load_n(&log->done, __ATOMIC_ACQUIRE)) {
+    struct timespec ts = {0, PERIOD_NS};
+    nanosleep(&ts, NULL);
+  }
+  ws2812b_rt_stop(rt);
+}
+
+// First CPU this process may run on, which is not necessarily CPU 0 (e.g. under taskset or in a
+// container).
+int util_allowed_cpu(void) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  TEST_ASSERT_EQUAL(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      return cpu;
+    }
+  }
+  TEST_FAIL_MESSAGE("No allowed CPU!");
+  return 0;
+}
+
+void util_config(ws2812b_rt_t *rt, frame_log_t *log, uint8_t **buffers, uint32_t buffer_count) {
+  memset(log, 0, sizeof(*log));
+  log->stall_frame = (uint64_t)-1;
+
+  memset(&rt->config, 0, sizeof(rt->config));
+  rt->config.frame = log_frame;
+  rt->config.ctx = log;
+  rt->config.period_ns = PERIOD_NS;
+  rt->config.pin_cpu = true;
+  rt->config.cpu = util_allowed_cpu();
+  rt->config.priority = 10;
+  rt->config.buffers = buffers;
+  rt->config.buffer_count = buffer_count;
+  rt->config.buffer_len = 10000;
+}
+
+// ======== Tests ==================================================================================
+
+void test_paced_frames(void) {
+  static uint8_t buffer_memory[2][10000];
+  uint8_t *buffers[2] = {buffer_memory[0], buffer_memory[1]};
+  memset(buffers[0], 0xAB, 10000);
+
+  ws2812b_rt_t rt;
+  frame_log_t log;
+  util_config(&rt, &log, buffers, 2);
+
+  util_run(&rt, &log);
+
+  // Without privileges, SCHED_FIFO is not available, but frames are still transmitted:
+  TEST_ASSERT_EQUAL(0, rt.degraded & ~WS2812B_RT_DEGRADED_SCHED);
+  TEST_ASSERT_EQUAL(FRAME_COUNT, rt.frames);
+
+  // Frames are paced by the period. Only the first frame can start late relative to the others:
+  for (uint32_t i = 1; i < FRAME_COUNT; i++) {
+    TEST_ASSERT_GREATER_OR_EQUAL(log.times[0] + i * (uint64_t)PERIOD_NS,
+                                 log.times[i] + rt.max_lateness_ns);
+  }
+
+  uint64_t histogram_total = 0;
+  for (uint32_t i = 0; i < WS2812B_RT_HISTOGRAM_BUCKETS; i++) {
+    histogram_total += rt.histogram[i];
+  }
+  TEST_ASSERT_EQUAL(FRAME_COUNT, histogram_total);
+
+  uint64_t p50 = ws2812b_rt_lateness_percentile(&rt, 50);
+  uint64_t p99 = ws2812b_rt_lateness_percentile(&rt, 99);
+  TEST_ASSERT_LESS_OR_EQUAL(p99, p50);
+  TEST_ASSERT_LESS_OR_EQUAL(rt.max_lateness_ns, p99);
+
+  // Prefaulting does not modify the buffers:
+  for (uint32_t i = 0; i < 10000; i++) {
+    TEST_ASSERT_EQUAL_HEX8(0xAB, buffers[0][i]);
+  }
+}
+
+void test_overrun_misses(void) {
+  ws2812b_rt_t rt;
+  frame_log_t log;
+  util_config(&rt, &log, 0, 0);
+
+  // Frame 5 takes 5.5 periods: The next 4 deadlines are skipped entirely,
+  // and the 5th is already late when frame 6 starts.
+  log.stall_frame = 5;
+  log.stall_ns = 5 * PERIOD_NS + PERIOD_NS / 2;
+  rt.config.miss_ns = PERIOD_NS / 4;
+
+  util_run(&rt, &log);
+
+  TEST_ASSERT_EQUAL(FRAME_COUNT, rt.frames);
+  TEST_ASSERT_GREATER_OR_EQUAL(5, rt.deadline_misses);
+  TEST_ASSERT_GREATER_OR_EQUAL(PERIOD_NS / 4, rt.max_lateness_ns);
+}
+
+void test_degrade_affinity(void) {
+  ws2812b_rt_t rt;
+  frame_log_t log;
+  util_config(&rt, &log, 0, 0);
+  rt.config.cpu = CPU_SETSIZE - 1;
+  rt.config.priority = 0;
+
+  util_run(&rt, &log);
+
+  TEST_ASSERT_EQUAL(WS2812B_RT_DEGRADED_AFFINITY, rt.degraded);
+  TEST_ASSERT_EQUAL(FRAME_COUNT, rt.frames);
+}
+
+void test_no_pinning_by_default(void) {
+  ws2812b_rt_t rt;
+  frame_log_t log;
+  util_config(&rt, &log, 0, 0);
+  rt.config.pin_cpu = false;
+  rt.config.cpu = CPU_SETSIZE - 1;
+  rt.config.priority = 0;
+
+  // The CPU is ignored without pin_cpu, so this invalid one is never applied.
+  util_run(&rt, &log);
+
+  TEST_ASSERT_EQUAL(0, rt.degraded);
+  TEST_ASSERT_EQUAL(FRAME_COUNT, rt.frames);
+}
+
+void test_percentiles(void) {
+  ws2812b_rt_t rt;
+  memset(&rt, 0, sizeof(rt));
+  TEST_ASSERT_EQUAL(0, ws2812b_rt_lateness_percentile(&rt, 50));
+
+  // 90 frames on time, 9 in [1024, 2048), 1 at 100000ns:
+  rt.histogram[0] = 90;
+  rt.histogram[11] = 9;
+  rt.histogram[17] = 1;
+  rt.max_lateness_ns = 100000;
+
+  TEST_ASSERT_EQUAL(0, ws2812b_rt_lateness_percentile(&rt, 50));
+  TEST_ASSERT_EQUAL(0, ws2812b_rt_lateness_percentile(&rt, 90));
+  TEST_ASSERT_EQUAL(2047, ws2812b_rt_lateness_percentile(&rt, 95));
+  TEST_ASSERT_EQUAL(2047, ws2812b_rt_lateness_percentile(&rt, 99));
+  TEST_ASSERT_EQUAL(100000, ws2812b_rt_lateness_percentile(&rt, 100));
+}
+
+void test_invalid_config(void) {
+  ws2812b_rt_t rt;
+  frame_log_t log;
+  util_config(&rt, &log, 0, 0);
+  rt.config.period_ns = 0;
+  TEST_ASSERT_EQUAL(-1, ws2812b_rt_start(&rt));
+  TEST_ASSERT_EQUAL(EINVAL, errno);
+  ws2812b_rt_stop(&rt);
+
+  util_config(&rt, &log, 0, 0);
+  rt.config.frame = 0;
+  TEST_ASSERT_EQUAL(-1, ws2812b_rt_start(&rt));
+  TEST_ASSERT_EQUAL(EINVAL, errno);
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_paced_frames);
+  RUN_TEST(test_overrun_misses);
+  RUN_TEST(test_degrade_affinity);
+  RUN_TEST(test_no_pinning_by_default);
+  RUN_TEST(test_percentiles);
+  RUN_TEST(test_invalid_config);
+  return UNITY_END();
+}
@@ -0,0 +1,283 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "ws2812b.h"
+#include "ws2812b_spidev.h"
+#include <linux/spi/spidev.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// ======== Fake spidev ============================================================================
+
+#define FAKE_MAX_MESSAGES 64
+#define FAKE_MAX_XFERS 256
+#define FAKE_MAX_DATA 4096
+
+typedef struct {
+  uint8_t mode;
+  uint8_t lsb_first;
+  uint8_t bits_per_word;
+  uint32_t max_speed_hz;
+
+  uint32_t message_count;
+  uint32_t message_len[FAKE_MAX_MESSAGES];
+  uint32_t message_xfers[FAKE_MAX_MESSAGES];
+
+  uint32_t xfer_count;
+  struct spi_ioc_transfer xfers[FAKE_MAX_XFERS]; // Every transfer of every message, in order
+  uint32_t data_len;
+  uint8_t data[FAKE_MAX_DATA];
+} fake_spidev_t;
+
+fake_spidev_t fake;
+
+int fake_ioctl(int fd, unsigned long request, void *arg) {
+  (void)(fd);
+
+  if (request == SPI_IOC_WR_MODE) {
+    fake.mode = *(uint8_t *)arg;
+  } else if (request == SPI_IOC_WR_LSB_FIRST) {
+    fake.lsb_first = *(uint8_t *)arg;
+  } else if (request == SPI_IOC_WR_BITS_PER_WORD) {
+    fake.bits_per_word = *(uint8_t *)arg;
+  } else if (request == SPI_IOC_WR_MAX_SPEED_HZ) {
+    fake.max_speed_hz = *(uint32_t *)arg;
+  } else if (_IOC_TYPE(request) == SPI_IOC_MAGIC && _IOC_NR(request) == 0) {
+    // SPI_IOC_MESSAGE(n)
+    struct spi_ioc_transfer *xfers = arg;
+    uint32_t n = _IOC_SIZE(request) / sizeof(struct spi_ioc_transfer);
+    uint32_t len = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+      if (fake.xfer_count < FAKE_MAX_XFERS) {
+        fake.xfers[fake.xfer_count] = xfers[i];
+      }
+      fake.xfer_count++;
+      memcpy(&fake.data[fake.data_len], (void *)(uintptr_t)xfers[i].tx_buf, xfers[i].len);
+      fake.data_len += xfers[i].len;
+      len += xfers[i].len;
+    }
+
+    fake.message_len[fake.message_count] = len;
+    fake.message_xfers[fake.message_count] = n;
+    fake.message_count++;
+    return len;
+  } else {
+    return -1;
+  }
+
+  return 0;
+}
+
+// ======== Utils ==================================================================================
+
+char device_path[] = "/tmp/ws2812b_spidev_XXXXXX";
+char bufsiz_path[] = "/tmp/ws2812b_bufsiz_XXXXXX";
+
+void util_write_bufsiz(const char *bufsiz) {
+  FILE *f = fopen(bufsiz_path, "w");
+  fputs(bufsiz, f);
+  fclose(f);
+}
+
+void util_setup(ws2812b_handle_t *h, ws2812b_led_t *leds, uint32_t led_count) {
+  for (uint32_t i = 0; i < led_count; i++) {
+    leds[i].red = i * 3;
+    leds[i].green = i * 5;
+    leds[i].blue = i * 7;
+  }
+
+  h->led_count = led_count;
+  h->leds = leds;
+  h->config.packing = WS2812B_PACKING_SINGLE;
+  h->config.pulse_len_0 = WS2812B_PULSE_LEN_2b;
+  h->config.pulse_len_1 = WS2812B_PULSE_LEN_6b;
+  h->config.first_bit_0 = WS2812B_FIRST_BIT_0_ENABLED;
+  h->config.spi_bit_order = WS2812B_LSB_FIRST;
+  h->config.prefix_len = 1;
+  h->config.suffix_len = 4;
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(h), "Init function failed!");
+
+  memset(&fake, 0, sizeof(fake));
+}
+
+void util_assert_xfers(uint32_t speed_hz) {
+  // Every transfer is sent back-to-back with the others: No CS change, no delay, 8 bits.
+  TEST_ASSERT_TRUE(fake.xfer_count <= FAKE_MAX_XFERS);
+  for (uint32_t i = 0; i < fake.xfer_count; i++) {
+    TEST_ASSERT_EQUAL_UINT32(speed_hz, fake.xfers[i].speed_hz);
+    TEST_ASSERT_EQUAL_UINT16(0, fake.xfers[i].delay_usecs);
+    TEST_ASSERT_EQUAL_UINT8(0, fake.xfers[i].cs_change);
+    TEST_ASSERT_EQUAL_UINT8(8, fake.xfers[i].bits_per_word);
+    TEST_ASSERT_TRUE(fake.xfers[i].rx_buf == 0);
+  }
+}
+
+// ======== Tests ==================================================================================
+
+void test_open_configures_port(void) {
+  ws2812b_led_t leds[1];
+  ws2812b_handle_t h;
+  util_setup(&h, leds, 1);
+
+  ws2812b_spidev_t dev = {.config = {.path = device_path,
+                                     .bufsiz_path = bufsiz_path,
+                                     .mode = SPI_MODE_1,
+                                     .ioctl = fake_ioctl}};
+  util_write_bufsiz("1234\n");
+
+  TEST_ASSERT_FALSE(ws2812b_spidev_open(&dev, &h));
+  TEST_ASSERT_EQUAL_UINT8(SPI_MODE_1, fake.mode);
+  TEST_ASSERT_EQUAL_UINT8(1, fake.lsb_first);
+  TEST_ASSERT_EQUAL_UINT8(8, fake.bits_per_word);
+  TEST_ASSERT_EQUAL_UINT32(WS2812B_SPIDEV_SPEED_SINGLE, fake.max_speed_hz);
+  TEST_ASSERT_EQUAL_UINT32(1234, dev.bufsiz);
+  ws2812b_spidev_close(&dev);
+
+  // Double packing, MSB first, explicit speed
+  h.config.packing = WS2812B_PACKING_DOUBLE;
+  h.config.pulse_len_0 = WS2812B_PULSE_LEN_1b;
+  h.config.pulse_len_1 = WS2812B_PULSE_LEN_2b;
+  h.config.spi_bit_order = WS2812B_MSB_FIRST;
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&h), "Init function failed!");
+  TEST_ASSERT_FALSE(ws2812b_spidev_open(&dev, &h));
+  TEST_ASSERT_EQUAL_UINT8(0, fake.lsb_first);
+  TEST_ASSERT_EQUAL_UINT32(WS2812B_SPIDEV_SPEED_DOUBLE, fake.max_speed_hz);
+  ws2812b_spidev_close(&dev);
+
+  dev.config.speed_hz = 3000000;
+  TEST_ASSERT_FALSE(ws2812b_spidev_open(&dev, &h));
+  TEST_ASSERT_EQUAL_UINT32(3000000, fake.max_speed_hz);
+  ws2812b_spidev_close(&dev);
+
+  // Unreadable buffer size falls back to default
+  util_write_bufsiz("");
+  TEST_ASSERT_FALSE(ws2812b_spidev_open(&dev, &h));
+  TEST_ASSERT_EQUAL_UINT32(WS2812B_SPIDEV_DEFAULT_BUFSIZ, dev.bufsiz);
+  ws2812b_spidev_close(&dev);
+
+  // Missing device
+  dev.config.path = "/nonexistent/spidev0.0";
+  TEST_ASSERT_TRUE(ws2812b_spidev_open(&dev, &h));
+}
+
+#define SPIDEV_LED_COUNT 50
+void test_transmit_split_at_bufsiz(void) {
+  ws2812b_led_t leds[SPIDEV_LED_COUNT];
+  ws2812b_handle_t h;
+  util_setup(&h, leds, SPIDEV_LED_COUNT);
+
+  ws2812b_spidev_t dev = {
+      .config = {.path = device_path, .bufsiz_path = bufsiz_path, .ioctl = fake_ioctl}};
+  util_write_bufsiz("500");
+  TEST_ASSERT_FALSE(ws2812b_spidev_open(&dev, &h));
+
+  uint8_t buf[WS2812B_REQUIRED_BUFFER_LEN(SPIDEV_LED_COUNT, WS2812B_PACKING_SINGLE, 1, 4)];
+  uint32_t len = ws2812b_required_buffer_len(&h);
+  ws2812b_fill_buffer(&h, buf);
+
+  TEST_ASSERT_FALSE(ws2812b_spidev_transmit(&dev, buf, len));
+
+  // 1205 bytes: Two full messages and one with the remainder, all at 6.4 MHz
+  TEST_ASSERT_EQUAL_UINT32(3, fake.message_count);
+  TEST_ASSERT_EQUAL_UINT32(500, fake.message_len[0]);
+  TEST_ASSERT_EQUAL_UINT32(500, fake.message_len[1]);
+  TEST_ASSERT_EQUAL_UINT32(205, fake.message_len[2]);
+  TEST_ASSERT_EQUAL_UINT32(3, fake.xfer_count);
+  util_assert_xfers(6400000);
+  TEST_ASSERT_EQUAL_UINT32(len, fake.data_len);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(buf, fake.data, len);
+
+  ws2812b_spidev_close(&dev);
+
+  // Double packing: 605 bytes, one full message and one with the remainder, all at 3.2 MHz
+  h.config.packing = WS2812B_PACKING_DOUBLE;
+  h.config.pulse_len_0 = WS2812B_PULSE_LEN_1b;
+  h.config.pulse_len_1 = WS2812B_PULSE_LEN_3b;
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(&h), "Init function failed!");
+  TEST_ASSERT_FALSE(ws2812b_spidev_open(&dev, &h));
+  memset(&fake.message_count, 0, sizeof(fake) - offsetof(fake_spidev_t, message_count));
+
+  len = ws2812b_required_buffer_len(&h);
+  ws2812b_fill_buffer(&h, buf);
+  TEST_ASSERT_FALSE(ws2812b_spidev_transmit(&dev, buf, len));
+
+  TEST_ASSERT_EQUAL_UINT32(2, fake.message_count);
+  TEST_ASSERT_EQUAL_UINT32(500, fake.message_len[0]);
+  TEST_ASSERT_EQUAL_UINT32(105, fake.message_len[1]);
+  TEST_ASSERT_EQUAL_UINT32(2, fake.xfer_count);
+  util_assert_xfers(3200000);
+  TEST_ASSERT_EQUAL_UINT32(len, fake.data_len);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(buf, fake.data, len);
+
+  ws2812b_spidev_close(&dev);
+}
+
+void test_transmit_segments(void) {
+  ws2812b_led_t leds[SPIDEV_LED_COUNT];
+  ws2812b_handle_t h;
+  util_setup(&h, leds, SPIDEV_LED_COUNT);
+  h.config.prefix_len = 10;
+  h.config.suffix_len = 2 * WS2812B_ZERO_BLOCK_LEN + 10;
+
+  ws2812b_spidev_t dev = {
+      .config = {.path = device_path, .bufsiz_path = bufsiz_path, .ioctl = fake_ioctl}};
+  util_write_bufsiz("4096");
+  TEST_ASSERT_FALSE(ws2812b_spidev_open(&dev, &h));
+
+  uint8_t expected[WS2812B_REQUIRED_BUFFER_LEN(SPIDEV_LED_COUNT, WS2812B_PACKING_SINGLE, 10,
+                                               2 * WS2812B_ZERO_BLOCK_LEN + 10)];
+  uint32_t len = ws2812b_required_buffer_len(&h);
+  ws2812b_fill_buffer(&h, expected);
+
+  uint8_t data[WS2812B_DATA_LEN(SPIDEV_LED_COUNT, WS2812B_PACKING_SINGLE)];
+  ws2812b_segment_t segments[WS2812B_REQUIRED_SEGMENT_COUNT(10, 2 * WS2812B_ZERO_BLOCK_LEN + 10)];
+  uint32_t count = ws2812b_fill_segments(&h, data, segments);
+
+  // All segments fit into a single message, one transfer each.
+  TEST_ASSERT_FALSE(ws2812b_spidev_transmit_segments(&dev, segments, count));
+  TEST_ASSERT_EQUAL_UINT32(1, fake.message_count);
+  TEST_ASSERT_EQUAL_UINT32(count, fake.message_xfers[0]);
+  util_assert_xfers(6400000);
+  TEST_ASSERT_EQUAL_UINT32(len, fake.data_len);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, fake.data, len);
+
+  // Small buffer size: Segments get split across messages, no message exceeds the buffer size.
+  util_write_bufsiz("100");
+  ws2812b_spidev_close(&dev);
+  TEST_ASSERT_FALSE(ws2812b_spidev_open(&dev, &h));
+  memset(&fake.message_count, 0, sizeof(fake) - offsetof(fake_spidev_t, message_count));
+
+  TEST_ASSERT_FALSE(ws2812b_spidev_transmit_segments(&dev, segments, count));
+  TEST_ASSERT_EQUAL_UINT32((len + 99) / 100, fake.message_count);
+  util_assert_xfers(6400000);
+  for (uint32_t i = 0; i < fake.message_count - 1; i++) {
+    TEST_ASSERT_EQUAL_UINT32(100, fake.message_len[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(len, fake.data_len);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, fake.data, len);
+
+  ws2812b_spidev_close(&dev);
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(void) {
+  close(mkstemp(device_path));
+  close(mkstemp(bufsiz_path));
+
+  UNITY_BEGIN();
+  RUN_TEST(test_open_configures_port);
+  RUN_TEST(test_transmit_split_at_bufsiz);
+  RUN_TEST(test_transmit_segments);
+  int result = UNITY_END();
+
+  unlink(device_path);
+  unlink(bufsiz_path);
+  return result;
+}
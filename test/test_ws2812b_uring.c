@@ -0,0 +1,249 @@
+#define _GNU_SOURCE
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "ws2812b.h"
+#include "ws2812b_uring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define OUTPUT_COUNT 4
+#define BUFFER_COUNT 8
+#define LED_COUNT 10
+#define FRAME_LEN WS2812B_REQUIRED_BUFFER_LEN(LED_COUNT, WS2812B_PACKING_SINGLE, 1, 4)
+
+// ======== Utils ==================================================================================
+
+uint8_t buffer_memory[BUFFER_COUNT][FRAME_LEN];
+uint8_t *buffers[BUFFER_COUNT];
+
+uint32_t completions[BUFFER_COUNT];
+int last_result;
+
+void on_complete(void *ctx, uint32_t buffer_index, int result) {
+  (*(uint32_t *)ctx)++;
+  completions[buffer_index]++;
+  last_result = result;
+}
+
+bool util_init(ws2812b_uring_t *ur, uint32_t *callback_count) {
+  for (uint32_t i = 0; i < BUFFER_COUNT; i++) {
+    buffers[i] = buffer_memory[i];
+  }
+  memset(completions, 0, sizeof(completions));
+
+  ur->config.buffers = buffers;
+  ur->config.buffer_count = BUFFER_COUNT;
+  ur->config.buffer_len = FRAME_LEN;
+  ur->config.on_complete = on_complete;
+  ur->config.ctx = callback_count;
+
+  if (ws2812b_uring_init(ur)) {
+    // io_uring may be disabled (kernel config, seccomp, sysctl).
+    return false;
+  }
+  return true;
+}
+
+void util_init_handle(ws2812b_handle_t *h, ws2812b_led_t *leds, uint8_t seed) {
+  for (uint32_t i = 0; i < LED_COUNT; i++) {
+    leds[i].red = seed + i;
+    leds[i].green = seed * 3 + i;
+    leds[i].blue = seed ^ i;
+  }
+
+  h->led_count = LED_COUNT;
+  h->leds = leds;
+  h->config.packing = WS2812B_PACKING_SINGLE;
+  h->config.pulse_len_0 = WS2812B_PULSE_LEN_2b;
+  h->config.pulse_len_1 = WS2812B_PULSE_LEN_6b;
+  h->config.first_bit_0 = WS2812B_FIRST_BIT_0_ENABLED;
+  h->config.spi_bit_order = WS2812B_MSB_FIRST;
+  h->config.prefix_len = 1;
+  h->config.suffix_len = 4;
+  TEST_ASSERT_FALSE_MESSAGE(ws2812b_init(h), "Init function failed!");
+}
+
+// ======== Tests ==================================================================================
+
+void test_frames_to_pipes(void) {
+  ws2812b_uring_t ur;
+  uint32_t callback_count = 0;
+  if (!util_init(&ur, &callback_count)) {
+    TEST_IGNORE_MESSAGE("io_uring not available.");
+  }
+
+  int pipes[OUTPUT_COUNT][2];
+  ws2812b_led_t leds[OUTPUT_COUNT][LED_COUNT];
+  ws2812b_handle_t handles[OUTPUT_COUNT];
+
+  for (uint32_t o = 0; o < OUTPUT_COUNT; o++) {
+    TEST_ASSERT_EQUAL_INT(0, pipe(pipes[o]));
+    util_init_handle(&handles[o], leds[o], o * 40);
+  }
+
+  for (uint32_t round = 0; round < 3; round++) {
+    // Queue one frame per output, submit all at once
+    for (uint32_t o = 0; o < OUTPUT_COUNT; o++) {
+      int index = ws2812b_uring_acquire(&ur);
+      TEST_ASSERT_TRUE(index >= 0);
+      leds[o][0].red = round;
+      ws2812b_fill_buffer(&handles[o], buffers[index]);
+      TEST_ASSERT_EQUAL_INT(0, ws2812b_uring_queue(&ur, pipes[o][1], index, FRAME_LEN));
+    }
+    TEST_ASSERT_EQUAL_INT(OUTPUT_COUNT, ws2812b_uring_submit(&ur));
+
+    // Wait for all completions. All buffers are free again afterwards.
+    TEST_ASSERT_EQUAL_INT(OUTPUT_COUNT, ws2812b_uring_reap(&ur, OUTPUT_COUNT));
+    TEST_ASSERT_EQUAL_UINT32(BUFFER_COUNT, ur.free_count);
+    TEST_ASSERT_EQUAL_INT(FRAME_LEN, last_result);
+
+    // Every output received its frame
+    for (uint32_t o = 0; o < OUTPUT_COUNT; o++) {
+      uint8_t expected[FRAME_LEN];
+      uint8_t received[FRAME_LEN];
+      ws2812b_fill_buffer(&handles[o], expected);
+      TEST_ASSERT_EQUAL_INT(FRAME_LEN, read(pipes[o][0], received, FRAME_LEN));
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, received, FRAME_LEN);
+    }
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(3 * OUTPUT_COUNT, callback_count);
+  TEST_ASSERT_EQUAL_UINT64(3 * OUTPUT_COUNT, ur.completed);
+  TEST_ASSERT_EQUAL_UINT64(0, ur.errors);
+
+  for (uint32_t o = 0; o < OUTPUT_COUNT; o++) {
+    close(pipes[o][0]);
+    close(pipes[o][1]);
+  }
+  ws2812b_uring_close(&ur);
+}
+
+void test_buffer_recycling(void) {
+  ws2812b_uring_t ur;
+  uint32_t callback_count = 0;
+  if (!util_init(&ur, &callback_count)) {
+    TEST_IGNORE_MESSAGE("io_uring not available.");
+  }
+
+  int fds[2];
+  TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+
+  // All buffers handed out in order, then none left
+  for (int i = 0; i < BUFFER_COUNT; i++) {
+    TEST_ASSERT_EQUAL_INT(i, ws2812b_uring_acquire(&ur));
+  }
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_uring_acquire(&ur));
+
+  // Reaping with nothing in flight returns immediately
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_uring_reap(&ur, 1));
+
+  // Queued writes are submitted by reap if needed
+  memset(buffers[5], 0xab, FRAME_LEN);
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_uring_queue(&ur, fds[1], 5, 16));
+  TEST_ASSERT_EQUAL_INT(1, ws2812b_uring_reap(&ur, 1));
+  TEST_ASSERT_EQUAL_UINT32(1, completions[5]);
+  TEST_ASSERT_EQUAL_INT(16, last_result);
+  TEST_ASSERT_EQUAL_INT(5, ws2812b_uring_acquire(&ur));
+
+  // Invalid arguments
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_uring_queue(&ur, fds[1], BUFFER_COUNT, 16));
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_uring_queue(&ur, fds[1], 0, FRAME_LEN + 1));
+
+  // Failed writes are reported and still recycle the buffer
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_uring_queue(&ur, -1, 3, 16));
+  TEST_ASSERT_EQUAL_INT(1, ws2812b_uring_submit(&ur));
+  TEST_ASSERT_EQUAL_INT(1, ws2812b_uring_reap(&ur, 1));
+  TEST_ASSERT_EQUAL_INT(-EBADF, last_result);
+  TEST_ASSERT_EQUAL_UINT64(1, ur.errors);
+  TEST_ASSERT_EQUAL_INT(EBADF, ur.last_error);
+
+  // Buffers have to be acquired before being queued, and can only be queued once
+  errno = 0;
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_uring_queue(&ur, fds[1], 3, 16));
+  TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+  TEST_ASSERT_EQUAL_INT(3, ws2812b_uring_acquire(&ur));
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_uring_queue(&ur, fds[1], 3, 16));
+  errno = 0;
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_uring_queue(&ur, fds[1], 3, 16));
+  TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+
+  // Only one write per file descriptor can be in flight, so that frames stay in order
+  errno = 0;
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_uring_queue(&ur, fds[1], 0, 16));
+  TEST_ASSERT_EQUAL_INT(EBUSY, errno);
+  TEST_ASSERT_EQUAL_INT(1, ws2812b_uring_reap(&ur, 1));
+  TEST_ASSERT_EQUAL_INT(16, last_result);
+  TEST_ASSERT_EQUAL_UINT32(1, ur.free_count);
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_uring_queue(&ur, fds[1], 0, 16));
+  TEST_ASSERT_EQUAL_INT(1, ws2812b_uring_reap(&ur, 1));
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_uring_acquire(&ur));
+  TEST_ASSERT_EQUAL_INT(3, ws2812b_uring_acquire(&ur));
+
+  close(fds[0]);
+  close(fds[1]);
+  ws2812b_uring_close(&ur);
+}
+
+#define SHORT_WRITE_LEN (4 * 4096)
+void test_short_write(void) {
+  static uint8_t memory[SHORT_WRITE_LEN];
+  uint8_t *buffer = memory;
+  uint32_t callback_count = 0;
+
+  ws2812b_uring_t ur;
+  ur.config.buffers = &buffer;
+  ur.config.buffer_count = 1;
+  ur.config.buffer_len = SHORT_WRITE_LEN;
+  ur.config.on_complete = on_complete;
+  ur.config.ctx = &callback_count;
+  if (ws2812b_uring_init(&ur)) {
+    TEST_IGNORE_MESSAGE("io_uring not available.");
+  }
+
+  // A non-blocking pipe with room for only part of the frame takes a partial write.
+  int fds[2];
+  TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+  TEST_ASSERT_TRUE(fcntl(fds[1], F_SETPIPE_SZ, SHORT_WRITE_LEN / 2) > 0);
+  TEST_ASSERT_EQUAL_INT(0, fcntl(fds[1], F_SETFL, O_NONBLOCK));
+
+  memset(completions, 0, sizeof(completions));
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_uring_acquire(&ur));
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_uring_queue(&ur, fds[1], 0, SHORT_WRITE_LEN));
+  TEST_ASSERT_EQUAL_INT(1, ws2812b_uring_reap(&ur, 1));
+  TEST_ASSERT_EQUAL_INT(-EIO, last_result);
+  TEST_ASSERT_EQUAL_UINT64(1, ur.errors);
+  TEST_ASSERT_EQUAL_INT(EIO, ur.last_error);
+  TEST_ASSERT_EQUAL_UINT32(1, callback_count);
+
+  // The buffer is recycled nonetheless
+  TEST_ASSERT_EQUAL_INT(0, ws2812b_uring_acquire(&ur));
+
+  close(fds[0]);
+  close(fds[1]);
+  ws2812b_uring_close(&ur);
+}
+
+void test_invalid_config(void) {
+  ws2812b_uring_t ur;
+  ur.config.buffers = buffers;
+  ur.config.buffer_count = 0;
+  ur.config.buffer_len = FRAME_LEN;
+  TEST_ASSERT_EQUAL_INT(-1, ws2812b_uring_init(&ur));
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_frames_to_pipes);
+  RUN_TEST(test_buffer_recycling);
+  RUN_TEST(test_short_write);
+  RUN_TEST(test_invalid_config);
+  return UNITY_END();
+}